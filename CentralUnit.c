@@ -4,13 +4,26 @@
  * serial monitor. The user mainly interacts with this node, giving it the
  * commands for the smart home and reading the feedbacks on the serial monitor.
  *
- * There exist 5 possible commands that the user may give to the CU. Each
- * command corresponds to a number N. The user decides the command N by
- * consecutively pressing N times the button of the CU. The command is actually
- * determined when 4 seconds have elapsed since the last button press. After
- * that, the CU is ready to receive a new command from the user. Every time the
- * CU is ready to receive a new command, it will have to show on the monitor the
- * set of possible commands with the associated number N:
+ * There exist 9 possible commands that the user may give to the CU, with its
+ * button or on the serial port (see the serial API at the end of this
+ * header). Each command corresponds to a number N. The user decides the
+ * command N by consecutively pressing N times the button of the CU, or
+ * holding the button for LONG_PRESS presses at once (see gesture.h). The
+ * command is actually determined when the button has been idle for a time
+ * adapted to the rhythm of the user (at most 4 seconds), or as soon as N is
+ * the highest command available. After that, the CU is ready to receive a new
+ * command from the user. Every time the CU is ready to receive a new command,
+ * it will have to show on the monitor the set of possible commands with the
+ * associated number N. The CU does not know
+ * the addresses of the nodes in advance: every node announces the commands it
+ * implements, and a command is sent to all the nodes that announced it over a
+ * single reliable connection shared by all of them (see registry.h), which is
+ * multi-hop when TRANSPORT_CONF_MESH is set (see transport.h). Commands 1
+ * and 3 are broadcast, and every node acknowledges them: the nodes that do not
+ * answer get the command again in unicast, and the CU shows how long it took
+ * until all of them confirmed (see groupcast.h). Commands are never discarded
+ * because the radio is busy: they wait in a bounded outbound queue, and the
+ * alarm command overtakes the queued ones:
  * 1. Activate/Deactivate the alarm signal - when the alarm signal is activated,
  * 		all the LEDs of Node1 and Node2 start blinking with a period of 2
  * 		seconds. When and only when the alarm is deactivated (the user gives
@@ -29,10 +42,25 @@
  * 		seconds (so, 2 seconds before the blue LED of Node2 stops blinking). The
  * 		16 seconds represent the time required for the gate/door to open and
  * 		then close. The 14 seconds represent the time required for the guest to
- * 		reach the entrance hall by crossing the garden;
- * 4. Obtain the average of the last 5 temperature values measured by Node1.
- * 		Node1 continuously measures temperature with a period of 10 seconds;
+ * 		reach the entrance hall by crossing the garden. The CU sends the
+ * 		whole sequence at once, with the deadlines of both nodes in network
+ * 		time (see sched.h), so the two blinkings stay in step;
+ * 4. Obtain the statistics (average, minimum, maximum, variance) of the last
+ * 		temperature values measured by Node1, all in a single reply. Node1
+ * 		continuously measures temperature, every 10 to 160 seconds depending
+ * 		on how fast it changes;
  * 5. Obtain the external light value measured by Node2.
+ * 6. Switch on/off the sauna/steam bath of Node4 (see below).
+ * 7. Obtain the temperature history of the last HISTORY_SPAN seconds, kept by
+ * 		Node1 on flash and streamed to the CU with a reliable bulk transfer.
+ * 8. Obtain the energy report of Node1, Node2 and Node4: the CPU, LPM and
+ * 		radio time each node has spent on every command and background task.
+ * 9. Dump the trace of the last radio and process events of the CU and of
+ * 		every node (serial port only, see trace.h and trace-merge.py).
+ * Commands 4 and 5 are answered by the CU itself, without using the radio,
+ * while the last reading received from the node is still fresh. In push mode
+ * (PUSH_CONF_ENABLED) Node1 and Node2 report every significant change on their
+ * own, so their readings are almost always available in the CU.
  *
  * Finally, the user also has the possibility to switch on and switch off the
  * lights in the garden. This is done by directly pressing the button of Node1.
@@ -44,17 +72,110 @@
  * invoking command 6 on the CU, and can switch it off by invoking the same
  * command once more. After the user decides the treatment (sauna or steam bath),
  * the CU is informed and shows it.
+ *
+ * A host or a test harness can give the same commands on the serial port, one
+ * per line, without waiting for the button timer:
+ * 		<id> <command> [argument]
+ * where id is a number chosen by the host, echoed in the response, and the
+ * command is its number or its name (alarm, gate, guest, temp, light, steam,
+ * history, energy, trace; "ping" only gets a response). The argument replaces the
+ * default of commands 4 (TEMP_STATS_* mask), 7 (seconds of history) and 8
+ * (energy slots mask). Every line is answered at once with one of:
+ * 		@<id> ok <command> <nodes>	sent to (or answered from the cache for)
+ * 									that many nodes, results follow as usual
+ * 		@<id> err unavailable <command>	disabled (alarm on) or not a command
+ * 		@<id> err no-node <command>	no node has announced the command yet
+ * 		@<id> err busy <command>		queue full, try again later
+ * 		@<id> err syntax
+ * The menu is only shown after commands given with the button.
+ *
+ * With OTA_CONF_ENABLED the host also gives the CU the updates of the nodes
+ * (see ota.h and mkdelta.py), a delta at a time:
+ * 		<id> ota <offset> <hex bytes>	store part of the delta (offset 0
+ * 										starts a new one)
+ * 		<id> ota send					disseminate it to the nodes
+ * answered with "@<id> ok ota <bytes of the delta>" or "@<id> err ota".
  */
 
 #include "contiki.h"
-#include "stdio.h"
 #include "sys/etimer.h"
 #include "dev/button-sensor.h"
+#include "dev/serial-line.h"
 #include "net/rime/rime.h"
+#include "net/netstack.h"
+#include "message.h"
+#include "txqueue.h"
+#include "cache.h"
+#include "tslog.h"
+#include "push.h"
+#include "energy.h"
+#include "registry.h"
+#include "transport.h"
+#include "groupcast.h"
+#include "sched.h"
+#include "serlog.h"
+#include "gesture.h"
+#include "trace.h"
+#include "ota.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 
 #define MAX_RETRANSMISSIONS 5
 
-static int last_command = 0;
+//unicast commands waiting to be sent, for all the nodes together
+#ifdef CU_CONF_MUX_QUEUE_SIZE
+#define MUX_QUEUE_SIZE CU_CONF_MUX_QUEUE_SIZE
+#else
+#define MUX_QUEUE_SIZE 8
+#endif
+
+/*freshness of the cached readings (seconds): Node1 samples temperature every
+ 10 seconds while it changes (less often only while it is stable), so a younger
+ average cannot be more accurate than the cached one.
+ In push mode the nodes report every significant change on their own, so a
+ reading stays valid until the maximum silence interval expires*/
+#ifdef CU_CONF_TEMP_TTL
+#define TEMP_TTL CU_CONF_TEMP_TTL
+#elif PUSH_ENABLED
+#define TEMP_TTL PUSH_MAX_SILENCE
+#else
+#define TEMP_TTL 10
+#endif
+#ifdef CU_CONF_LIGHT_TTL
+#define LIGHT_TTL CU_CONF_LIGHT_TTL
+#elif PUSH_ENABLED
+#define LIGHT_TTL PUSH_MAX_SILENCE
+#else
+#define LIGHT_TTL 5
+#endif
+
+//temperature statistics asked to Node1 by command 4
+#ifdef CU_CONF_TEMP_STATS
+#define TEMP_STATS CU_CONF_TEMP_STATS
+#else
+#define TEMP_STATS TEMP_STATS_ALL
+#endif
+
+//time range (seconds before now) of the temperature history asked by command 7
+#ifdef CU_CONF_HISTORY_SPAN
+#define HISTORY_SPAN CU_CONF_HISTORY_SPAN
+#else
+#define HISTORY_SPAN 3600
+#endif
+
+/*command 3: time (ms) the gate/door takes to open and close, and time the
+ guest takes to cross the garden from the gate to the door*/
+#ifdef CU_CONF_OPEN_TIME
+#define OPEN_TIME CU_CONF_OPEN_TIME
+#else
+#define OPEN_TIME 16000
+#endif
+#ifdef CU_CONF_WALK_TIME
+#define WALK_TIME CU_CONF_WALK_TIME
+#else
+#define WALK_TIME 14000
+#endif
 
 //disactivated alarm by default
 static int alarm = 0;
@@ -68,89 +189,586 @@ static int steam_room_treatment = 0; //=1 sauna; =2 steam bath
 
 static process_event_t print;
 
+//the menu is shown to the user of the button, not to a host on the serial port
+static int show_menu = 1;
+
+/*keep the radio listening instead of duty cycling it: the CU is mains-powered
+ (set by the radio profiles of project-conf.h)*/
+#ifdef CU_CONF_RADIO_ON
+#define RADIO_ON CU_CONF_RADIO_ON
+#else
+#define RADIO_ON 0
+#endif
+
+//commands given with the button
+#define COMMANDS 8
+
+//presses worth a long press of the button
+#ifdef CU_CONF_LONG_PRESS
+#define LONG_PRESS CU_CONF_LONG_PRESS
+#else
+#define LONG_PRESS 4
+#endif
+
+static struct gesture gesture;
+
+//results of enqueue_command() besides the number of nodes
+#define CMD_UNAVAILABLE 0
+#define CMD_NO_NODE -1
+#define CMD_BUSY -2
+
 PROCESS(WaitCommandProcess, "Wait command");
 PROCESS(PrintCommandsProcess, "Print commands");
 
-static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
-	printf("broadcast message received from %d.%d\n", from->u8[0], from->u8[1]);
+//reading code of each TEMP_STATS_* bit
+static const uint8_t temp_stats_codes[] = {READING_TEMP_AVG, READING_TEMP_MIN,
+		READING_TEMP_MAX, READING_TEMP_VAR, READING_TEMP_COUNT};
+
+static void print_reading(uint8_t code, int value) {
+	switch (code) {
+	case READING_TEMP_AVG:
+		serlog(LOG_TEMP_AVG, value);
+		break;
+	case READING_TEMP_MIN:
+		serlog(LOG_TEMP_MIN, value);
+		break;
+	case READING_TEMP_MAX:
+		serlog(LOG_TEMP_MAX, value);
+		break;
+	case READING_TEMP_VAR:
+		//hundredths of C^2
+		serlog(LOG_TEMP_VAR, value/100, value%100);
+		break;
+	case READING_TEMP_COUNT:
+		serlog(LOG_TEMP_COUNT, value);
+		break;
+	case READING_LIGHT:
+		serlog(LOG_LIGHT, value);
+		break;
+	}
 }
 
-static void broadcast_sent(struct broadcast_conn *c, int status, int num_tx){
-	printf("broadcast message sent (status %d), transmission number %d\n", status, num_tx);
+//features charged to each energy slot (see energy.h)
+static const char *const energy_slot_names[ENERGY_SLOTS] = {"Alarm",
+		"Gate lock", "Guest entrance", "Temperature query", "Light query",
+		"Steam room", "Temperature monitoring", "Steam room measurements"};
+
+static void print_energy(uint8_t slot, const struct msg_record *record) {
+	if (slot>=ENERGY_SLOTS || record->len<ENERGY_RECORD_LEN)
+		return;
+	serlog(LOG_ENERGY, energy_slot_names[slot],
+			(unsigned long)msg_get_uint32(&record->value[4*ENERGY_CPU]),
+			(unsigned long)msg_get_uint32(&record->value[4*ENERGY_LPM]),
+			(unsigned long)msg_get_uint32(&record->value[4*ENERGY_RX]),
+			(unsigned long)msg_get_uint32(&record->value[4*ENERGY_TX]));
+}
 
-	/*broadcast commands do not require any answer: CU can accept a new command
-	as soon as the broadcast command is sent*/
-	process_post(&PrintCommandsProcess, print, NULL);
+/*outbound queue of the unicast commands to any node: one frame in flight for
+ the whole house, as the transport has only one*/
+TXQUEUE(mux_queue, MUX_QUEUE_SIZE);
+
+//a group command (1 or 3) has been acknowledged by the nodes
+static void group_done(uint8_t command, uint8_t acked, uint8_t members,
+		unsigned long elapsed) {
+	if (acked==members)
+		serlog(LOG_GROUP_CONFIRMED, command, members, elapsed);
+	else
+		serlog(LOG_GROUP_PARTIAL, command, acked, members, elapsed);
 }
 
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno) {
-	printf("runicast message received from %d.%d, seqno %d\n", from->u8[0], from->u8[1], seqno);
-	int* data = (int*)packetbuf_dataptr();
-	int measure = *data;
+static void recv_unicast(const linkaddr_t *from, uint8_t seqno) {
+	serlog(LOG_UNICAST_RECV, from->u8[0], from->u8[1], seqno);
+	struct msg_reader reader;
+	struct msg_record record;
+	struct registry_node *node = registry_find(from);
+	int temp_received = 0;
+	int energy_received = 0;
+	int trace_received = 0;
+	int type;
+
+	type = msg_open(&reader);
+	if (type==MSG_REPORT) {
+		/*unsolicited report (push mode, or registration of a node in multi-hop
+		 mode): just refresh the cache or the registry*/
+		while (msg_next(&reader, &record)) {
+			if (record.code==READING_CAPS)
+				registry_update(from, msg_int16(&record));
+			else
+				cache_put(from, record.code, msg_int16(&record));
+		}
+		serlog(LOG_READINGS_UPDATED, from->u8[0], from->u8[1]);
+		return;
+	} else if (type!=MSG_READING) {
+		serlog(LOG_MALFORMED, from->u8[0], from->u8[1]);
+		return;
+	}
+
+	while (msg_next(&reader, &record)) {
+		int measure;
+
+		//energy report (command 8): not a measurement, never cached
+		if (record.code>=READING_ENERGY) {
+			if (!energy_received)
+				serlog(LOG_ENERGY_REPORT, from->u8[0], from->u8[1]);
+			energy_received = 1;
+			print_energy(record.code-READING_ENERGY, &record);
+			continue;
+		} else if (record.code==READING_TRACE) {
+			trace_received = 1;
+			trace_print(from, record.value, record.len);
+			continue;
+		}
 
-	//message from Node4 can arrive at any moment
-	if (from->u8[0]==4) {
-		steam_room_treatment = measure;
+		measure = msg_int16(&record);
 
-		if (measure==0) {
-			steam_room_on = 0;
-			printf("\nThe steam room has been automatically turned off\n");
+		cache_put(from, record.code, measure);
+
+		//message from Node4 can arrive at any moment
+		if (record.code==READING_TREATMENT) {
+			steam_room_treatment = measure;
+
+			if (measure==0) {
+				steam_room_on = 0;
+				serlog(LOG_STEAM_AUTO_OFF);
+			}
+		} else {
+			if (record.code!=READING_LIGHT)
+				temp_received = 1;
+			print_reading(record.code, measure);
 		}
-	} else if (last_command==4) {
-		if (measure==-100)
-			printf("\nNo temperature measurements available yet\n");
-		else
-			printf("\nTemperature (avg of last 5 measurements): %d C\n", measure);
-	} else if (last_command==5) {
-		printf("\nOuter light: %d lux\n", measure);
 	}
 
-	//once the response is received, a new command can be accepted
+	//a temperature node answers with no record if it has not measured anything yet
+	if (node!=NULL && (node->caps & CAP_TEMP) && !temp_received && !energy_received
+			&& !trace_received)
+		serlog(LOG_NO_TEMP);
+
 	process_post(&PrintCommandsProcess, print, NULL);
 }
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+static void sent_unicast(const linkaddr_t *to, uint8_t retransmissions) {
+	serlog(LOG_UNICAST_SENT, to->u8[0], to->u8[1], retransmissions);
+	txqueue_done(&mux_queue);
+}
+
+static void timedout_unicast(const linkaddr_t *to, uint8_t retransmissions) {
+	serlog(LOG_UNICAST_TIMEDOUT, to->u8[0], to->u8[1], retransmissions);
+	txqueue_done(&mux_queue);
+}
+
+static struct tslog_decoder history;
+
+static void write_history(struct rucb_conn *c, int offset, int flag, char *data, int len) {
+	int i;
 
-	/*command 4 and 5 require a response and so you have to wait it before
-	 accepting a new command; command 2 does not require any response and so
-	 the CU is able to accept a new command as soon as the message is sent*/
-	if (last_command==2 || last_command==6)
+	if (flag & RUCB_FLAG_NEWFILE) {
+		tslog_decoder_init(&history, 1);
+		serlog(LOG_HISTORY_BEGIN);
+	}
+
+	for (i=0; i<len; i++) {
+		if (tslog_decode(&history, data[i])) {
+			serlog(LOG_HISTORY_SAMPLE, history.now-history.time, history.value);
+		}
+	}
+
+	if (flag & RUCB_FLAG_LASTCHUNK) {
+		serlog(LOG_HISTORY_END);
 		process_post(&PrintCommandsProcess, print, NULL);
+	}
+}
+
+static const struct rucb_callbacks rucb_calls = {write_history, NULL, NULL};
+static struct rucb_conn rucb;
+
+//the deadlines of the schedule are relative to the age of the frame
+static void group_prepare(clock_time_t elapsed) {
+	sched_restamp(3, elapsed);
+}
+
+static const struct groupcast_callbacks groupcast_calls = {NULL, group_done, group_prepare};
+static const struct transport_callbacks transport_calls = {recv_unicast, sent_unicast, timedout_unicast};
+
+static int transmit_unicast(struct txqueue *q) {
+	linkaddr_t to;
+
+	//the destination has been stored with the frame by txqueue_enqueue_to()
+	linkaddr_copy(&to, packetbuf_addr(PACKETBUF_ADDR_RECEIVER));
+	serlog(LOG_SENDING_COMMAND, to.u8[0], to.u8[1]);
+	if (!transport_send(&to, MAX_RETRANSMISSIONS)) {
+		serlog(LOG_SEND_DEFERRED, to.u8[0], to.u8[1]);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * Answer queries 4 and 5 for a node from the cache if its last reading is still
+ * fresh. Returns 0 on a miss (the query has to go over the radio).
+ */
+static int answer_from_cache(int command, unsigned long arg, const linkaddr_t *node) {
+	int16_t values[sizeof(temp_stats_codes)];
+	unsigned long age = 0;
+	int i;
+
+	if (command==4) {
+		if ((arg & TEMP_STATS_ALL)==0)
+			return 0;
+		//all the requested statistics must be fresh
+		for (i=0; i<sizeof(temp_stats_codes); i++) {
+			if ((arg & (1<<i))
+					&& !cache_get(node, temp_stats_codes[i], TEMP_TTL, &values[i], &age))
+				return 0;
+		}
+		serlog(LOG_CACHED, age);
+		for (i=0; i<sizeof(temp_stats_codes); i++) {
+			if (arg & (1<<i))
+				print_reading(temp_stats_codes[i], values[i]);
+		}
+		return 1;
+	} else if (command==5) {
+		if (cache_get(node, READING_LIGHT, LIGHT_TTL, &values[0], &age)) {
+			serlog(LOG_CACHED, age);
+			print_reading(READING_LIGHT, values[0]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//capability a node must have announced to receive a command
+static uint16_t command_caps(int command) {
+	switch (command) {
+	case 1:
+		return CAP_ALARM;
+	case 3:
+		return CAP_GUEST;
+	case 2:
+		return CAP_GATE;
+	case 4:
+	case 7:
+		return CAP_TEMP;
+	case 5:
+		return CAP_LIGHT;
+	case 6:
+		return CAP_STEAM;
+	case 8:
+		return CAP_ENERGY;
+	case 9:
+		return CAP_TRACE;
+	}
+	return 0;
 }
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+/*
+ * Command 3 as a single schedule: the node with the gate blinks at once for
+ * OPEN_TIME, the other ones start WALK_TIME later, when the guest reaches the
+ * door. Without a schedule the nodes count the same delays on their own.
+ */
+static void add_guest_schedule(void) {
+	struct sched_action actions[SCHED_RECORD_ACTIONS];
+	struct registry_node *n;
+	uint16_t start;
+	int i = 0;
+
+	/*as many nodes as fit in the frame: the others find no action of theirs
+	 and start blinking as soon as they receive it*/
+	for (n=registry_first(CAP_GUEST); n!=NULL && i+2<=SCHED_RECORD_ACTIONS; n=registry_next(n, CAP_GUEST)) {
+		start = (n->caps & CAP_GATE)? 0:WALK_TIME;
+		linkaddr_copy(&actions[i].target, &n->addr);
+		actions[i].action = ACTION_BLINK_ON;
+		actions[i++].offset = start;
+		linkaddr_copy(&actions[i].target, &n->addr);
+		actions[i].action = ACTION_BLINK_OFF;
+		actions[i++].offset = start+OPEN_TIME;
+	}
+	if (!sched_add(3, actions, i))
+		msg_add(3, NULL, 0);
+}
+
+//build in the packetbuf the frame of a command, with its argument
+static void build_command(int command, unsigned long arg) {
+	msg_init(MSG_COMMAND);
+	if (command==3 && !TRANSPORT_MESH) {
+		/*the transport may retransmit the frame unchanged after more than a
+		 wrap of the network time: in multi-hop mode the nodes count the
+		 delays on their own*/
+		add_guest_schedule();
+	} else if (command==4) {
+		uint8_t stats = arg;
+		msg_add(command, &stats, 1);
+	} else if (command==7) {
+		uint8_t range[8];
+		msg_put_uint32(range, arg);
+		msg_put_uint32(&range[4], 0);
+		msg_add(command, range, sizeof(range));
+	} else if (command==8) {
+		uint8_t slots = arg;
+		msg_add(command, &slots, 1);
+	} else
+		msg_add(command, NULL, 0);
+}
+
+/*
+ * Send the command: group commands in acknowledged broadcast, the others in
+ * the shared queue, once for every node that implements them (unless the
+ * answer is already in the cache). Commands are never dropped because the
+ * connection is busy: they wait in the queue and the alarm command overtakes
+ * the others. In multi-hop mode the group commands go in the queue too, as
+ * broadcasts do not cross the hops. arg is the argument of commands 4, 7 and
+ * 8, 0 for the default. Returns the number of nodes the command has been sent
+ * to, or one of the CMD_* errors.
+ */
+static int enqueue_command(int command, unsigned long arg) {
+	struct registry_node *n;
+	uint16_t caps;
+	int queued = 0, nodes = 0;
+
+	if (arg==0) {
+		if (command==4)
+			arg = TEMP_STATS;
+		else if (command==7)
+			arg = HISTORY_SPAN;
+		else if (command==8)
+			arg = ENERGY_ALL;
+	}
+
+	if (!TRANSPORT_MESH && (command==1 || command==3)) {
+		if (command==3 && alarm==1)
+			return CMD_UNAVAILABLE;
+		//the alarm may take the place of a guest entrance still unconfirmed
+		build_command(command, arg);
+		nodes = groupcast_send(command_caps(command), command==1);
+		if (nodes==0) {
+			serlog(LOG_NO_NODE, command);
+			return CMD_NO_NODE;
+		} else if (nodes<0) {
+			serlog(LOG_TOO_MANY_GROUPS, command);
+			return CMD_BUSY;
+		}
+		serlog(LOG_COMMAND_SENT, command, nodes);
+		queued = nodes;
+	} else if (alarm==1 && command!=1) {
+		//all the other commands are disabled while the alarm is on
+		return CMD_UNAVAILABLE;
+	} else if ((caps = command_caps(command))==0) {
+		return CMD_UNAVAILABLE;
+	} else {
+		//the ring of the CU is printed at once, the nodes send theirs
+		if (command==9)
+			trace_dump(NULL);
+		for (n=registry_first(caps); n!=NULL; n=registry_next(n, caps)) {
+			nodes++;
+			if (answer_from_cache(command, arg, &n->addr)) {
+				queued++;
+				continue;
+			}
+			//a transmission started by the previous enqueue may reuse the packetbuf
+			build_command(command, arg);
+			if (!txqueue_enqueue_to(&mux_queue, &n->addr, command==1)) {
+				serlog(LOG_QUEUE_FULL, command, n->addr.u8[0], n->addr.u8[1]);
+				continue;
+			}
+			queued++;
+		}
+		if (nodes==0) {
+			serlog(LOG_NO_NODE, command);
+			return CMD_NO_NODE;
+		}
+		if (queued)
+			serlog(LOG_COMMAND_QUEUED, command, txqueue_len(&mux_queue));
+	}
+
+	//update the state of the house as soon as the command is accepted
+	if (!queued)
+		return CMD_BUSY;
+	if (command==1)
+		alarm = (alarm==0)?1:0;
+	else if (command==2)
+		unlocked_gate = (unlocked_gate==1)?0:1;
+	else if (command==6) {
+		steam_room_on = (steam_room_on==0)? 1:0;
+		if (steam_room_on == 0)
+			steam_room_treatment = 0;
+	}
+
+	return queued;
+}
+
+//names of the commands on the serial port, from command 1
+static const char *const command_names[] = {"alarm", "gate", "guest", "temp",
+		"light", "steam", "history", "energy", "trace"};
+
+#if OTA_ENABLED
+//longest part of a delta in a line of the serial port
+#define OTA_LINE_BYTES 32
+
+//store a part of an update or send it (see the top of this file)
+static void ota_command(unsigned int id, const char *arg) {
+	uint8_t buf[OTA_LINE_BYTES];
+	unsigned long offset;
+	char *end;
+	char hex[3] = {0, 0, 0};
+	int len = 0, result;
+
+	if (strcmp(arg, "send")==0)
+		result = ota_send();
+	else {
+		offset = strtoul(arg, &end, 10);
+		if (end==arg || *end!=' ' || offset>0xffff) {
+			serlog(LOG_API_SYNTAX, id);
+			return;
+		}
+		for (arg=end+1; arg[0]!='\0' && arg[1]!='\0' && len<OTA_LINE_BYTES; arg+=2) {
+			hex[0] = arg[0];
+			hex[1] = arg[1];
+			buf[len++] = strtoul(hex, &end, 16);
+			if (end!=&hex[2]) {
+				serlog(LOG_API_SYNTAX, id);
+				return;
+			}
+		}
+		if (len==0 || *arg!='\0') {
+			serlog(LOG_API_SYNTAX, id);
+			return;
+		}
+		result = ota_store(offset, buf, len);
+	}
+
+	if (result<0)
+		serlog(LOG_API_OTA_ERR, id);
+	else
+		serlog(LOG_API_OTA, id, result);
 }
+#endif
+
+//parse and run a line of the serial protocol (see the top of this file)
+static void serial_command(const char *line) {
+	char *end, *number;
+	const char *word;
+	unsigned int id;
+	unsigned long arg = 0;
+	int command = 0, len, result;
+
+	id = strtoul(line, &end, 10);
+	if (end==line || *end!=' ') {
+		serlog(LOG_API_SYNTAX, id);
+		return;
+	}
+	while (*end==' ')
+		end++;
+	word = end;
+	while (*end!=' ' && *end!='\0')
+		end++;
+	len = end-word;
+	if (len==0) {
+		serlog(LOG_API_SYNTAX, id);
+		return;
+	}
 
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv, broadcast_sent}; //Be careful to the order: receive callback always before send one (you should always specify both)
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast1, runicast2, runicast4;
+	if (len==4 && strncmp(word, "ping", 4)==0) {
+		serlog(LOG_API_PONG, id);
+		return;
+	}
+#if OTA_ENABLED
+	if (len==3 && strncmp(word, "ota", 3)==0) {
+		while (*end==' ')
+			end++;
+		ota_command(id, end);
+		return;
+	}
+#endif
+	if (*word>='0' && *word<='9') {
+		command = strtoul(word, &number, 10);
+		if (number!=end) {
+			serlog(LOG_API_SYNTAX, id);
+			return;
+		}
+	} else {
+		while (command<sizeof(command_names)/sizeof(command_names[0])
+				&& (strlen(command_names[command])!=len || strncmp(word, command_names[command], len)!=0))
+			command++;
+		command++;
+	}
+
+	while (*end==' ')
+		end++;
+	if (*end!='\0') {
+		//only the queries have an argument
+		if (command!=4 && command!=7 && command!=8) {
+			serlog(LOG_API_SYNTAX, id);
+			return;
+		}
+		errno = 0;
+		arg = strtoul(end, &end, 10);
+		//the argument must fit the field of its command (see build_command())
+		if (arg==0 || *end!='\0' || errno==ERANGE || (uint32_t)arg!=arg
+				|| (command==4 && (arg & ~(unsigned long)TEMP_STATS_ALL)!=0)
+				|| (command==8 && arg>ENERGY_ALL)) {
+			serlog(LOG_API_SYNTAX, id);
+			return;
+		}
+	}
+
+	result = enqueue_command(command, arg);
+	if (result>0)
+		serlog(LOG_API_OK, id, command, result);
+	else if (result==CMD_NO_NODE)
+		serlog(LOG_API_NO_NODE, id, command);
+	else if (result==CMD_BUSY)
+		serlog(LOG_API_BUSY, id, command);
+	else
+		serlog(LOG_API_UNAVAILABLE, id, command);
+}
+
+//a command has been entered with the button
+static void button_command(uint8_t command) {
+	show_menu = 1;
+	if (enqueue_command(command, 0)==CMD_UNAVAILABLE) {
+		/*command not available because not implemented or not
+		allowed (because alarm in on) */
+		serlog(LOG_NOT_AVAILABLE, command);
+	}
+	process_post(&PrintCommandsProcess, print, NULL);
+}
 
 AUTOSTART_PROCESSES(&WaitCommandProcess, &PrintCommandsProcess);
 
 PROCESS_THREAD(WaitCommandProcess, ev, data) {
 
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast1));
-	PROCESS_EXITHANDLER(runicast_close(&runicast2));
+	PROCESS_EXITHANDLER(groupcast_close());
+	PROCESS_EXITHANDLER(transport_close());
+	PROCESS_EXITHANDLER(rucb_close(&rucb));
 
 	PROCESS_BEGIN();
 
-	static struct etimer et;
-	static int num_button_presses = 0;
+	serlog_init();
+	trace_init();
 
-	//open broadcast connection with Node1 and Node2
-	broadcast_open(&broadcast, 129, &broadcast_call);
-	//open runicast connection with Node1
-	runicast_open(&runicast1, 144, &runicast_calls);
-	//open runicast connection with Node2
-	runicast_open(&runicast2, 145, &runicast_calls);
-	//open runicast connection with Node4
-	runicast_open(&runicast4, 146, &runicast_calls);
+	//duty cycling stays off: frames still go out with the strobes of the RDC
+	if (RADIO_ON)
+		NETSTACK_RDC.off(1);
+
+	//open the acknowledged broadcast connection with Node1 and Node2
+	groupcast_open(129, &groupcast_calls);
+	//the CU is the reference of the network time
+	timesynch_set_authority_level(0);
+	//open the reliable connection shared by all the nodes
+	transport_open(144, &transport_calls);
+	//open bulk transfer connection with Node1 (temperature history)
+	rucb_open(&rucb, 150, &rucb_calls);
+#if OTA_ENABLED
+	//send and relay the updates of the nodes
+	ota_open(160, NULL, NULL);
+#endif
+
+	txqueue_init(&mux_queue, NULL, &linkaddr_null, transmit_unicast);
+
+	//learn the nodes of the house from their announcements
+	registry_init();
 
 	SENSORS_ACTIVATE(button_sensor);
+	gesture_init(&gesture, &button_sensor, 4*CLOCK_SECOND, LONG_PRESS, button_command);
 
 	print = process_alloc_event();
 
@@ -160,61 +778,12 @@ PROCESS_THREAD(WaitCommandProcess, ev, data) {
 	while(1) {
 		PROCESS_WAIT_EVENT();
 		if (ev==sensors_event && data==&button_sensor) {
-			num_button_presses++;
-			etimer_set(&et, 4*CLOCK_SECOND);
-		} else if (etimer_expired(&et)) {
-			last_command = num_button_presses;
-			if (!runicast_is_transmitting(&runicast1)
-				&& !runicast_is_transmitting(&runicast2)
-				&& !runicast_is_transmitting(&runicast4)) {
-				linkaddr_t recv;
-				packetbuf_copyfrom((void*)&num_button_presses, sizeof(int));
-				if (num_button_presses == 1 || num_button_presses == 3) {
-					//send the command in broadcast to Node1 and Node2
-					if (num_button_presses == 1) {
-						alarm = (alarm==0)?1:0;
-						printf("Sending command %d in broadcast\n", num_button_presses);
-						broadcast_send(&broadcast);
-					} else {
-						if (alarm == 0) {
-							printf("Sending command %d in broadcast\n", num_button_presses);
-							broadcast_send(&broadcast);
-						}
-					}
-				} else {
-					if (num_button_presses == 4 && alarm == 0) {
-						//send the command in unicast to Node1
-						recv.u8[0] = 1;
-						recv.u8[1] = 0;
-						printf("Sending command %d to %d.%d\n", num_button_presses, recv.u8[0], recv.u8[1]);
-						runicast_send(&runicast1, &recv, MAX_RETRANSMISSIONS);
-					} else if ((num_button_presses == 2 || num_button_presses == 5)
-							&& alarm == 0) {
-						//send the command in unicast to Node2
-						if (num_button_presses ==2)
-							unlocked_gate = (unlocked_gate==1)?0:1;
-						recv.u8[0] = 2;
-						recv.u8[1] = 0;
-						printf("Sending command %d to %d.%d\n", num_button_presses, recv.u8[0], recv.u8[1]);
-						runicast_send(&runicast2, &recv, MAX_RETRANSMISSIONS);
-					} else if (num_button_presses == 6 && alarm == 0) {
-						//send the command in unicast to Node4
-						steam_room_on = (steam_room_on==0)? 1:0;
-						if (steam_room_on == 0)
-							steam_room_treatment = 0;
-						recv.u8[0] = 4;
-						recv.u8[1] = 0;
-						printf("Sending command %d to %d.%d\n", num_button_presses, recv.u8[0], recv.u8[1]);
-						runicast_send(&runicast4, &recv, MAX_RETRANSMISSIONS);
-					} else {
-						/*command not available because not implemented or not
-						allowed (because alarm in on) */
-						printf("\nCommand %d not available\n", num_button_presses);
-						process_post(&PrintCommandsProcess, print, NULL);
-					}
-				}
-			}
-			num_button_presses = 0;
+			//with the alarm on, the first press already gives command 1
+			gesture_set_valid(&gesture, (alarm==1)? 1<<1:((1<<(COMMANDS+1))-2));
+			gesture_press(&gesture);
+		} else if (ev==serial_line_event_message) {
+			show_menu = 0;
+			serial_command((const char *)data);
 		}
 	}
 	PROCESS_END();
@@ -225,30 +794,34 @@ PROCESS_THREAD(PrintCommandsProcess, ev, data) {
 
 	while(1) {
 		PROCESS_WAIT_EVENT_UNTIL(ev==print);
+		if (!show_menu)
+			continue;
 
-		printf("\nPOSSIBLE COMMANDS\n");
+		//2 bytes per line: the text is expanded when the CU is idle
+		serlog(LOG_MENU);
+		if (LONG_PRESS>0)
+			serlog(LOG_MENU_LONG_PRESS, LONG_PRESS);
 		if (alarm==1)
-			printf("1. Deactivate the alarm signal\n");
+			serlog(LOG_MENU_ALARM_OFF);
 		else {
-			printf("1. Activate the alarm signal\n");
+			serlog(LOG_MENU_ALARM_ON);
 			if (unlocked_gate==1)
-				printf("2. Lock the gate\n");
+				serlog(LOG_MENU_LOCK);
 			else
-				printf("2. Unlock the gate\n");
-			printf("3. Open (and automatically close) both the door and the gate in order to let a guest enter\n");
-			printf("4. Obtain the average of the last 5 temperature values\n");
-			printf("5. Obtain the external light value\n");
+				serlog(LOG_MENU_UNLOCK);
+			serlog(LOG_MENU_GUEST);
+			serlog(LOG_MENU_TEMP);
+			serlog(LOG_MENU_LIGHT);
 			if (steam_room_on==0)
-				printf("6. Switch steam room on\n\n");
-			else {
-				printf("6. Switch steam room off");
-				if (steam_room_treatment==1)
-					printf(" (working as sauna)\n\n");
-				else if (steam_room_treatment==2)
-					printf(" (working as steam bath)\n\n");
-				else
-					printf("\n\n");
-			}
+				serlog(LOG_MENU_STEAM_ON);
+			else if (steam_room_treatment==1)
+				serlog(LOG_MENU_SAUNA_OFF);
+			else if (steam_room_treatment==2)
+				serlog(LOG_MENU_STEAM_BATH_OFF);
+			else
+				serlog(LOG_MENU_STEAM_OFF);
+			serlog(LOG_MENU_HISTORY, HISTORY_SPAN/60);
+			serlog(LOG_MENU_ENERGY);
 		}
 	}
 
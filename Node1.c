@@ -15,8 +15,27 @@
  * 		and must last for 16 seconds. The blue LEDof Node2 immediately starts
  * 		blinking, whereas the blue LED of Node1 starts blinking only after 14
  * 		seconds (so, 2 seconds before the blue LED of Node2 stops blinking).
- * 4. Obtain the average of the last 5 temperature values measured by Node1.
- * 		Node1 continuously measures temperature with a period of 10 seconds;
+ * 		The CU usually sends both deadlines in network time (see sched.h).
+ * 4. Obtain the statistics (average, minimum, maximum, variance) of the last
+ * 		TEMP_WINDOW temperature values measured by Node1. Node1 continuously
+ * 		measures temperature, by default every 10 seconds while it changes
+ * 		and up to every 160 seconds while it is stable (see pacer.h); the
+ * 		average is weighted by the time each sample stands for. The
+ * 		statistics are updated in constant time at every sample and the CU
+ * 		chooses which of them it wants in the reply;
+ * 7. Obtain the temperature history of a time range. Every sample is also
+ * 		appended to a delta-encoded log on flash, which survives reboots; the
+ * 		samples of the requested range are streamed to the CU with a reliable
+ * 		bulk transfer (rucb) instead of one runicast message per value.
+ * 8. Obtain the energy report: the CPU, LPM and radio time spent on every
+ * 		command and on the temperature monitoring (see energy.h).
+ * 9. Send the trace of the last radio and process events to the CU (see
+ * 		trace.h).
+ *
+ * In push mode (PUSH_CONF_ENABLED) Node1 also reports its temperature statistics
+ * to the CU on its own, whenever the average moves by at least
+ * NODE1_CONF_PUSH_DELTA tenths of C or nothing has been reported for
+ * PUSH_MAX_SILENCE seconds.
  *
  * Finally, the user also has the possibility to switch on and switch off the
  * lights in the garden. This is done by directly pressing the button of Node1.
@@ -25,110 +44,217 @@
  * green one is off.
  */
 
+#define HOME_NODE Node1
+
 #include "contiki.h"
-#include "stdio.h"
 #include "sys/etimer.h"
-#include "dev/sht11/sht11-sensor.h"
 #include "dev/leds.h"
 #include "dev/button-sensor.h"
 #include "net/rime/rime.h"
 #include "lib/random.h"
-
-#define MAX_RETRANSMISSIONS 5
-
-static int command;
-static int temp_measurements[5] = {-100, -100, -100, -100, -100};
-static int alarm = 0;
-static unsigned char led_status;
+#include "message.h"
+#include "wstats.h"
+#include "tslog.h"
+#include "push.h"
+#include "pacer.h"
+#include "sht11-sampler.h"
+#include "energy.h"
+#include "home.h"
+#include "node.h"
+#include "transport.h"
+#include "groupcast.h"
+#include "ledpat.h"
+#include "serlog.h"
+#include "trace.h"
+
+//number of temperature samples the statistics are computed on
+#ifdef NODE1_CONF_TEMP_WINDOW
+#define TEMP_WINDOW NODE1_CONF_TEMP_WINDOW
+#else
+#define TEMP_WINDOW 5
+#endif
+
+/*bounds of the sampling period (seconds): beyond 254 s every sample of the
+ history costs an anchor instead of a delta (see tslog.h)*/
+#ifdef NODE1_CONF_MIN_PERIOD
+#define MIN_PERIOD NODE1_CONF_MIN_PERIOD
+#else
+#define MIN_PERIOD 10
+#endif
+#ifdef NODE1_CONF_MAX_PERIOD
+#define MAX_PERIOD NODE1_CONF_MAX_PERIOD
+#else
+#define MAX_PERIOD 160
+#endif
+
+//variance of the window (tenths of C squared) below which it is stable...
+#ifdef NODE1_CONF_STABLE_VAR
+#define STABLE_VAR NODE1_CONF_STABLE_VAR
+#else
+#define STABLE_VAR 4
+#endif
+//...and above which the period drops to MIN_PERIOD
+#ifdef NODE1_CONF_ACTIVE_VAR
+#define ACTIVE_VAR NODE1_CONF_ACTIVE_VAR
+#else
+#define ACTIVE_VAR 25
+#endif
+
+//the same for the change of the average, in tenths of C per hour
+#ifdef NODE1_CONF_STABLE_RATE
+#define STABLE_RATE NODE1_CONF_STABLE_RATE
+#else
+#define STABLE_RATE 60
+#endif
+#ifdef NODE1_CONF_ACTIVE_RATE
+#define ACTIVE_RATE NODE1_CONF_ACTIVE_RATE
+#else
+#define ACTIVE_RATE 360
+#endif
+
+/*add up to +/-3 C of random noise to the samples, to exercise the statistics
+ in the simulator (it keeps the sampling at MIN_PERIOD)*/
+#ifdef NODE1_CONF_TEMP_NOISE
+#define TEMP_NOISE NODE1_CONF_TEMP_NOISE
+#else
+#define TEMP_NOISE 0
+#endif
+
+//temperature samples in tenths of C
+WSTATS(temp_stats, TEMP_WINDOW);
+static const struct pacer_limits temp_limits = {MIN_PERIOD, MAX_PERIOD,
+		STABLE_VAR, ACTIVE_VAR, STABLE_RATE, ACTIVE_RATE};
+static struct pacer temp_pacer;
+static uint8_t requested_stats;
+static uint8_t history_busy = 0;
+
+//minimum change of the average (tenths of C) that is pushed to the CU
+#ifdef NODE1_CONF_PUSH_DELTA
+#define PUSH_DELTA NODE1_CONF_PUSH_DELTA
+#else
+#define PUSH_DELTA 5
+#endif
+
+#if PUSH_ENABLED
+static struct push temp_push;
+#endif
+//Command 3 without a schedule: the guest reaches the door after 14 seconds
+static struct ctimer door_timer;
 
 PROCESS(BaseProcess, "Base process");
 PROCESS(TempProcess, "Temperature monitoring process");
 
-//Command 1: start/stop alarm
-PROCESS(AlarmProcess, "Alarm process");
-PROCESS(StopAlarmProcess, "Stop alarm process");
-
-//Command 3: open gate/door process
-PROCESS(BlinkingProcess, "Blinking process");
-PROCESS(StopBlinkingProcess, "Stop blinking process");
-PROCESS(OpenDoorProcess, "Open gate process");
-
 //Command 4: send temperature measurements
 PROCESS(SendTempProcess, "Send temperature process");
 
-
-static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
-	int* data = (int*)packetbuf_dataptr();
-	command = *data;
-	printf("broadcast message received from %d.%d\nCommand: %d\n", from->u8[0], from->u8[1], command); //sender address + communication buffer
-	if (command==1) {
-		if (alarm==0)
-			process_start(&AlarmProcess, NULL);
-		else
-			process_start(&StopAlarmProcess, NULL);
-	} else if (command==3) {
-		if (alarm==0)
-			process_start(&OpenDoorProcess, NULL);
+/*
+ * Build in the packetbuf a frame with the requested temperature statistics.
+ * There is no record at all if no measurement is available yet.
+ */
+static void build_temp_stats(uint8_t type, uint8_t stats) {
+	msg_init(type);
+	if (wstats_count(&temp_stats)==0)
+		return;
+
+	if (stats & TEMP_STATS_AVG)
+		msg_add_int16(READING_TEMP_AVG, wstats_mean(&temp_stats));
+	if (stats & TEMP_STATS_MIN)
+		msg_add_int16(READING_TEMP_MIN, wstats_min(&temp_stats));
+	if (stats & TEMP_STATS_MAX)
+		msg_add_int16(READING_TEMP_MAX, wstats_max(&temp_stats));
+	if (stats & TEMP_STATS_VAR) {
+		uint32_t var = wstats_variance(&temp_stats);
+		msg_add_int16(READING_TEMP_VAR, (var>INT16_MAX)? INT16_MAX:var);
 	}
+	if (stats & TEMP_STATS_COUNT)
+		msg_add_int16(READING_TEMP_COUNT, wstats_count(&temp_stats));
 }
 
-static void broadcast_sent(struct broadcast_conn *c, int status, int num_tx){
-	printf("broadcast message sent (status %d), transmission number %d\n", status, num_tx);
-}
+//Command 7: stream the temperature history to the CU
+static int read_history(struct rucb_conn *c, int offset, char *to, int maxsize) {
+	int len = tslog_export_read(offset, (uint8_t*)to, maxsize);
 
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno) {
-	int* data = (int*)packetbuf_dataptr();
-	command = *data;
-	printf("runicast message received from %d.%d, seqno %d\nCommand: %d\n", from->u8[0], from->u8[1], seqno, command);
-	if (command==4) {
-		if (alarm==0)
-			process_start(&SendTempProcess, NULL);
-	}
+	//a short chunk is the last one
+	if (len<maxsize)
+		history_busy = 0;
+	return len;
 }
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+static void timedout_history(struct rucb_conn *c) {
+	serlog(LOG_HISTORY_TIMEDOUT);
+	history_busy = 0;
 }
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+static const struct rucb_callbacks rucb_calls = {NULL, read_history, timedout_history};
+static struct rucb_conn rucb;
+
+//Command 3 without a schedule: blink for 16 seconds once the guest arrives
+static void open_door(void *ptr) {
+	ledpat_start(LEDPAT_LAYER_GUEST, LEDPAT_GUEST, 16*CLOCK_SECOND);
 }
 
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv, broadcast_sent};
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
+//commands of Node1, the CU is the sender
+static void handle_command(const struct msg_record *record, const linkaddr_t *from) {
+	int command = record->code;
 
+	if (command==1) {
+		node_alarm_toggle();
+	} else if (command==3 && !node_alarm_on()) {
+		if (node_guest(record))
+			ctimer_set(&door_timer, 14*CLOCK_SECOND, open_door, NULL);
+	} else if (command==4) {
+		//the argument selects the statistics, the average by default
+		requested_stats = (record->len>0)? record->value[0]:TEMP_STATS_AVG;
+		if (!node_alarm_on()) {
+			energy_begin(ENERGY_SLOT_COMMAND(4));
+			process_start(&SendTempProcess, NULL);
+		}
+	} else if (command==7 && record->len==8) {
+		//stream the samples taken between from_age and to_age seconds ago
+		if (!node_alarm_on() && !history_busy) {
+			history_busy = 1;
+			tslog_export_start(msg_get_uint32(record->value), msg_get_uint32(&record->value[4]));
+			serlog(LOG_SENDING_HISTORY, from->u8[0], from->u8[1]);
+			rucb_send(&rucb, from);
+		}
+	}
+}
+
+//an update replaces this file (see ota.h)
+static void exit_node(void) {
+	ctimer_stop(&door_timer);
+	rucb_close(&rucb);
+	history_busy = 0;
+	sht11_sampler_cancel(&TempProcess);
+}
 
 AUTOSTART_PROCESSES(&BaseProcess, &TempProcess);
 
 PROCESS_THREAD(BaseProcess, ev, data) {
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
 	int outer_lights_off;
 
 	PROCESS_BEGIN();
 
-	//open broadcast connection with Node2 and CU
-	broadcast_open(&broadcast, 129, &broadcast_call);
+	node_init(HOME_ADDR, HOME_CAPS, handle_command, exit_node);
 
-	//open runicast connection with CU
-	runicast_open(&runicast, 144, &runicast_calls);
+	//commands 1 and 3 come in acknowledged broadcast
+	node_open_group();
+
+	//open bulk transfer connection with CU (temperature history)
+	rucb_open(&rucb, 150, &rucb_calls);
 
 	SENSORS_ACTIVATE(button_sensor);
 
 	//start with outer lights off
 	outer_lights_off = 1;
-	leds_on(LEDS_RED);
+	ledpat_on(LEDS_RED);
 
 	while(1){
 		//when the button is pressed, switch on/off the outer lights
 		PROCESS_WAIT_EVENT_UNTIL(ev==sensors_event && data==&button_sensor);
-		if (alarm==0) {
+		if (!node_alarm_on()) {
 			outer_lights_off= (outer_lights_off==1)? 0:1;
-			leds_toggle(LEDS_GREEN);
-			leds_toggle(LEDS_RED);
+			ledpat_toggle(LEDS_GREEN | LEDS_RED);
 		}
 	}
 
@@ -137,145 +263,79 @@ PROCESS_THREAD(BaseProcess, ev, data) {
 
 PROCESS_THREAD(TempProcess, ev, data) {
 	static struct etimer et_temp;
-	int index = 0;
+	static unsigned long last_sample;
+	unsigned long now;
+	uint16_t period;
 	int temp;
 
 	PROCESS_BEGIN();
 
-	//monitor temperature every 10 seconds
-	etimer_set(&et_temp, 10*CLOCK_SECOND);
+	sht11_sampler_init();
+	wstats_init(&temp_stats);
+	tslog_init("temp");
+#if PUSH_ENABLED
+	push_init(&temp_push, PUSH_DELTA, PUSH_MAX_SILENCE);
+#endif
+	pacer_init(&temp_pacer, &temp_limits);
+
+	//first sample after the minimum period
+	etimer_set(&et_temp, pacer_period(&temp_pacer)*CLOCK_SECOND);
+	last_sample = clock_seconds();
 
 	while(1) {
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_temp));
-
-		SENSORS_ACTIVATE(sht11_sensor);
-
-		//adjust the sensed value
-		temp = (sht11_sensor.value(SHT11_SENSOR_TEMP)/10-396)/10;
-		/*randomize: as RANDOM_RAND_MAX=65535, random_rand()/10000 returns
-		approximately 6 values --> +/-3 C*/
-		temp += (int)random_rand()/10000;
-
-		SENSORS_DEACTIVATE(sht11_sensor);
-
-		temp_measurements[index]=temp;
-		index=(index+1)%5;
+		energy_begin(ENERGY_SLOT_TEMP);
+
+		//the sampler posts an event when the temperature is available
+		sht11_sampler_request(PROCESS_CURRENT(), SHT11_SAMPLER_TEMP);
+		PROCESS_WAIT_EVENT_UNTIL(ev==sht11_sampler_event);
+
+		//adjust the sensed value (tenths of C)
+		temp = sht11_sampler_temp();
+#if TEMP_NOISE
+		/*randomize: as RANDOM_RAND_MAX=65535, (int16_t)random_rand()/1000
+		returns approximately 65 values, from -32 to 32 --> +/-3 C*/
+		temp += (int16_t)random_rand()/1000;
+#endif
+
+		//a sample stands for the time since the previous one
+		now = clock_seconds();
+		wstats_add_weighted(&temp_stats, temp, (now>last_sample)? now-last_sample:1);
+		last_sample = now;
+		tslog_append(temp);
+
+		//stretch the period while the temperature is stable
+		period = pacer_period(&temp_pacer);
+		if (pacer_update(&temp_pacer, wstats_mean(&temp_stats),
+				wstats_variance(&temp_stats))!=period)
+			serlog(LOG_TEMP_PERIOD, pacer_period(&temp_pacer));
+
+#if PUSH_ENABLED
+		//report the statistics only if the average has changed enough
+		if (push_needed(&temp_push, wstats_mean(&temp_stats))) {
+			build_temp_stats(MSG_REPORT, TEMP_STATS_ALL);
+			//the report is charged to the monitoring until it is acknowledged
+			if (node_send(ENERGY_SLOT_TEMP))
+				push_sent(&temp_push, wstats_mean(&temp_stats));
+		} else
+#endif
+			energy_end(ENERGY_SLOT_TEMP);
 
 		//printf("Temperature: %d C\n", temp);
 
-		etimer_reset(&et_temp);
-	}
-
-	PROCESS_END();
-}
-
-PROCESS_THREAD(AlarmProcess, ev, data) {
-	static struct etimer et_alarm;
-
-	PROCESS_BEGIN();
-
-	alarm = 1;
-
-	//save the led state
-	led_status = leds_get();
-	leds_off(LEDS_ALL);
-
-	etimer_set(&et_alarm, CLOCK_SECOND);
-
-	while(1){
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_alarm));
-		leds_toggle(LEDS_ALL);
-		etimer_reset(&et_alarm);
-	}
-
-	PROCESS_END();
-}
-
-PROCESS_THREAD(StopAlarmProcess, ev, data) {
-	PROCESS_BEGIN();
-
-	alarm = 0;
-
-	//kill blinking process
-	process_exit(&AlarmProcess);
-
-	//restore the led state
-	leds_set(led_status);
-
-	PROCESS_END();
-}
-
-PROCESS_THREAD(BlinkingProcess, ev, data) {
-	static struct etimer et_blink;
-	PROCESS_BEGIN();
-
-	etimer_set(&et_blink, CLOCK_SECOND);
-
-	while(1){
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_blink));
-		leds_toggle(LEDS_BLUE);
-		etimer_reset(&et_blink);
+		etimer_reset_with_new_interval(&et_temp, pacer_period(&temp_pacer)*CLOCK_SECOND);
 	}
 
 	PROCESS_END();
 }
 
-PROCESS_THREAD(StopBlinkingProcess, ev, data) {
-	static struct etimer et_stop_blinking;
-	PROCESS_BEGIN();
-
-	//blinking must last 16 seconds
-	etimer_set(&et_stop_blinking, 16*CLOCK_SECOND);
-	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_stop_blinking));
-	process_exit(&BlinkingProcess);
-
-	PROCESS_END();
-}
-
-PROCESS_THREAD(OpenDoorProcess, ev, data) {
-	static struct etimer et_door;
-	PROCESS_BEGIN();
-
-	led_status = leds_get();
-
-	//Node1 has to wait 14 seconds before start blinking
-	etimer_set(&et_door, 14*CLOCK_SECOND);
-
-	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_door));
-
-	//start blinking process
-	process_start(&BlinkingProcess, NULL);
-	process_start(&StopBlinkingProcess, NULL);
-
-	PROCESS_END();
-}
-
 PROCESS_THREAD(SendTempProcess, ev, data) {
 	PROCESS_BEGIN();
+	TRACE_BEGIN();
 
-	int sum = 0;
-	int num_elements = 0;
-	int i;
-	for (i=0; i<5; i++) {
-		if (temp_measurements[i]!=-100) {
-			sum += temp_measurements[i];
-			num_elements++;
-		}
-	}
-
-	int avg = -100;
-	if (num_elements!=0)
-		avg = sum/num_elements;
-
-	//transmit the avg of temperature measurements to the CU
-	if(!runicast_is_transmitting(&runicast)){
-		linkaddr_t recv;
-		recv.u8[0] = 3;
-		recv.u8[1] = 0;
-		packetbuf_copyfrom((void*)&avg, sizeof(int));
-		printf("Sending temperature %d C to %d.%d\n", avg, recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	}
+	//transmit the requested statistics to the CU, all in the same frame
+	build_temp_stats(MSG_READING, requested_stats);
+	if (node_send(ENERGY_SLOT_COMMAND(4)))
+		serlog(LOG_SENDING_TEMP, TRANSPORT_SINK, 0);
 	PROCESS_END();
 }
-
@@ -20,209 +20,191 @@
  * 		and must last for 16 seconds. The blue LEDof Node2 immediately starts
  * 		blinking, whereas the blue LED of Node1 starts blinking only after 14
  * 		seconds (so, 2 seconds before the blue LED of Node2 stops blinking).
+ * 		The CU usually sends both deadlines in network time (see sched.h).
  * 5. Obtain the external light value measured by Node2.
+ * 8. Obtain the energy report: the CPU, LPM and radio time spent on every
+ * 		command (see energy.h).
+ * 9. Send the trace of the last radio and process events to the CU (see
+ * 		trace.h).
  *
+ * In push mode (PUSH_CONF_ENABLED) Node2 samples the light every LIGHT_PERIOD
+ * seconds in the background and reports it to the CU on its own, whenever it
+ * moves by at least NODE2_CONF_PUSH_DELTA lux or nothing has been reported for
+ * PUSH_MAX_SILENCE seconds; command 5 is then answered with the last sample,
+ * without activating the sensor in the request path.
  */
 
+#define HOME_NODE Node2
+
 #include "contiki.h"
-#include <stdio.h>
 #include "sys/etimer.h"
 #include "dev/leds.h"
+#if CONTIKI_TARGET_NATIVE
+#include "native-sensors.h"
+#else
 #include "dev/light-sensor.h"
+#endif
 #include "net/rime/rime.h"
-
-#define MAX_RETRANSMISSIONS 5
+#include "message.h"
+#include "push.h"
+#include "energy.h"
+#include "home.h"
+#include "node.h"
+#include "transport.h"
+#include "groupcast.h"
+#include "ledpat.h"
+#include "serlog.h"
+#include "trace.h"
+
+//sampling period (seconds) and minimum change (lux) pushed to the CU
+#ifdef NODE2_CONF_LIGHT_PERIOD
+#define LIGHT_PERIOD NODE2_CONF_LIGHT_PERIOD
+#else
+#define LIGHT_PERIOD 5
+#endif
+#ifdef NODE2_CONF_PUSH_DELTA
+#define PUSH_DELTA NODE2_CONF_PUSH_DELTA
+#else
+#define PUSH_DELTA 20
+#endif
 
 
-static int command;
 static int unlocked_gate;
-static int alarm = 0;
-static unsigned char led_status;
+#if PUSH_ENABLED
+static int last_light;
+static struct push light_push;
+#endif
 
 
 PROCESS(BaseProcess, "Base process");
 
-//Command 1: start/stop alarm
-PROCESS(AlarmProcess, "Alarm process");
-PROCESS(StopAlarmProcess, "Stop alarm process");
-
 //Command 2: lock/unlock gate
 PROCESS(GateUnlockProcess, "Gate lock and unlock process");
 
-//Command 3: open gate/door process
-PROCESS(BlinkingProcess, "Blinking process");
-PROCESS(OpenGateProcess, "Open gate process");
-
 //Command 5: send light measurements
 PROCESS(SendLightProcess, "Send light process");
 
+#if PUSH_ENABLED
+PROCESS(LightProcess, "Light monitoring process");
+#endif
 
-static void broadcast_recv(struct broadcast_conn *c, const linkaddr_t *from){
-	int* data = (int*)packetbuf_dataptr();
-	command = *data;
-	printf("broadcast message received from %d.%d\nCommand: %d\n", from->u8[0], from->u8[1], command);
-	if (command==1) {
-		if (alarm==0)
-			process_start(&AlarmProcess, NULL);
-		else
-			process_start(&StopAlarmProcess, NULL);
-	} else if (command==3) {
-		if (alarm==0)
-			process_start(&OpenGateProcess, NULL);
-	}
-}
 
-static void broadcast_sent(struct broadcast_conn *c, int status, int num_tx){
-	printf("broadcast message sent (status %d), transmission number %d\n", status, num_tx);
-}
+//commands of Node2, the CU is the sender
+static void handle_command(const struct msg_record *record, const linkaddr_t *from) {
+	int command = record->code;
 
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno) {
-	int* data = (int*)packetbuf_dataptr();
-	command = *data;
-	printf("runicast message received from %d.%d, seqno %d\nCommand: %d\n", from->u8[0], from->u8[1], seqno, command);
-	if (command==2) {
-		if (alarm==0)
+	if (command==1) {
+		node_alarm_toggle();
+	} else if (command==3 && !node_alarm_on()) {
+		if (node_guest(record))
+			ledpat_start(LEDPAT_LAYER_GUEST, LEDPAT_GUEST, 16*CLOCK_SECOND);
+	} else if (command==2) {
+		if (!node_alarm_on())
 			process_start(&GateUnlockProcess, NULL);
 	} else if (command==5) {
-		if (alarm==0)
+		if (!node_alarm_on()) {
+			energy_begin(ENERGY_SLOT_COMMAND(5));
 			process_start(&SendLightProcess, NULL);
+		}
 	}
 }
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
-}
-
-static const struct broadcast_callbacks broadcast_call = {broadcast_recv, broadcast_sent};
-static struct broadcast_conn broadcast;
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
-
+#if PUSH_ENABLED
+AUTOSTART_PROCESSES(&BaseProcess, &LightProcess);
+#else
 AUTOSTART_PROCESSES(&BaseProcess);
+#endif
 
 PROCESS_THREAD(BaseProcess, ev, data) {
-	PROCESS_EXITHANDLER(broadcast_close(&broadcast));
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
 	PROCESS_BEGIN();
 
-	//open broadcast connection with Node1 and CU
-	broadcast_open(&broadcast, 129, &broadcast_call);
+	node_init(HOME_ADDR, HOME_CAPS, handle_command, NULL);
 
-	//open runicast connection with CU
-	runicast_open(&runicast, 145, &runicast_calls);
+	//commands 1 and 3 come in acknowledged broadcast
+	node_open_group();
 
 	//start with unlocked gate
 	unlocked_gate = 1;
-	leds_on(LEDS_GREEN);
+	ledpat_on(LEDS_GREEN);
 
 	PROCESS_WAIT_EVENT_UNTIL(0);
 
 	PROCESS_END();
 }
 
-PROCESS_THREAD(AlarmProcess, ev, data) {
-	static struct etimer et_alarm;
-
-	PROCESS_BEGIN();
-
-	alarm = 1;
-
-	//save the led state
-	led_status = leds_get();
-	leds_off(LEDS_ALL);
-
-	etimer_set(&et_alarm, CLOCK_SECOND);
-
-	while(1){
-		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_alarm));
-		leds_toggle(LEDS_ALL);
-		etimer_reset(&et_alarm);
-	}
-
-	PROCESS_END();
-}
-
-PROCESS_THREAD(StopAlarmProcess, ev, data) {
+PROCESS_THREAD(GateUnlockProcess, ev, data) {
 	PROCESS_BEGIN();
+	TRACE_BEGIN();
 
-	alarm = 0;
-
-	//kill blinking process
-	process_exit(&AlarmProcess);
-
-	//restore the led state
-	leds_set(led_status);
+	energy_begin(ENERGY_SLOT_COMMAND(2));
+	unlocked_gate = (unlocked_gate==1)? 0:1;
+	ledpat_toggle(LEDS_GREEN | LEDS_RED);
+	energy_end(ENERGY_SLOT_COMMAND(2));
 
 	PROCESS_END();
 }
 
-PROCESS_THREAD(GateUnlockProcess, ev, data) {
-	PROCESS_BEGIN();
+static int sample_light(void) {
+	int light;
 
-	unlocked_gate = (unlocked_gate==1)? 0:1;
-	leds_toggle(LEDS_GREEN);
-	leds_toggle(LEDS_RED);
+	SENSORS_ACTIVATE(light_sensor);
+	//adjust the sensed value
+	light = 10*light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC)/7;
+	SENSORS_DEACTIVATE(light_sensor);
+	TRACE_DETAIL(TRACE_SAMPLE, TRACE_SENSOR_LIGHT, light);
 
-	PROCESS_END();
+	return light;
 }
 
-PROCESS_THREAD(BlinkingProcess, ev, data) {
-	static struct etimer et_blink;
+PROCESS_THREAD(SendLightProcess, ev, data) {
 	PROCESS_BEGIN();
+	TRACE_BEGIN();
 
-	etimer_set(&et_blink, CLOCK_SECOND);
+#if PUSH_ENABLED
+	//the light is already sampled in the background
+	int light = last_light;
+#else
+	int light = sample_light();
+#endif
 
-	while(1){
-			PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_blink));
-			leds_toggle(LEDS_BLUE);
-			etimer_reset(&et_blink);
-		}
+	//transmit the light measurement to the CU
+	msg_init(MSG_READING);
+	msg_add_int16(READING_LIGHT, light);
+	if (node_send(ENERGY_SLOT_COMMAND(5))) {
+		serlog(LOG_SENDING_LIGHT, light, TRANSPORT_SINK, 0);
+#if PUSH_ENABLED
+		push_sent(&light_push, light);
+#endif
+	}
 
 	PROCESS_END();
 }
 
-PROCESS_THREAD(OpenGateProcess, ev, data) {
-	static struct etimer et_gate;
-	PROCESS_BEGIN();
-
-	led_status = leds_get();
-
-	//start blinking process
-	process_start(&BlinkingProcess, NULL);
-	etimer_set(&et_gate, 16*CLOCK_SECOND);
+#if PUSH_ENABLED
+PROCESS_THREAD(LightProcess, ev, data) {
+	static struct etimer et_light;
 
-	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_gate));
-	process_exit(&BlinkingProcess);
+	PROCESS_BEGIN();
 
-	//restore the led state
-	leds_set(led_status);
+	push_init(&light_push, PUSH_DELTA, PUSH_MAX_SILENCE);
+	etimer_set(&et_light, LIGHT_PERIOD*CLOCK_SECOND);
 
-	PROCESS_END();
-}
+	while(1) {
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_light));
 
-PROCESS_THREAD(SendLightProcess, ev, data) {
-	PROCESS_BEGIN();
+		last_light = sample_light();
 
-	SENSORS_ACTIVATE(light_sensor);
-	//adjust the sensed value
-	int light = 10*light_sensor.value(LIGHT_SENSOR_PHOTOSYNTHETIC)/7;
-	SENSORS_DEACTIVATE(light_sensor);
+		//report the light only if it has changed enough
+		if (push_needed(&light_push, last_light)) {
+			msg_init(MSG_REPORT);
+			msg_add_int16(READING_LIGHT, last_light);
+			if (node_send(ENERGY_SLOTS))
+				push_sent(&light_push, last_light);
+		}
 
-	//transmit the light measurement to the CU
-	if(!runicast_is_transmitting(&runicast)){
-		linkaddr_t recv;
-		recv.u8[0] = 3;
-		recv.u8[1] = 0;
-		packetbuf_copyfrom((void*)&light, sizeof(int));
-		printf("Sending light %d lux to %d.%d\n", light, recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
+		etimer_reset(&et_light);
 	}
 
 	PROCESS_END();
 }
+#endif
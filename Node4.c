@@ -4,8 +4,9 @@
  * The user can start this sensor by invoking the command 6 on the CU and can
  * stop it by invoking the same command.
  * By pressing the button of Node4 once, the sauna is selected and  by pressing
- * it twice, the steam bath is selected. The command is actually determined when
- * 3 seconds have elapsed since the last button press. After that, a message is
+ * it twice (or holding it), the steam bath is selected. The steam bath is
+ * selected as soon as the second press arrives, the sauna when no second press
+ * follows within DOUBLE_PRESS_TIME (see gesture.h). After that, a message is
  * sent to the CU to inform it about the choice. At this point, Node4 starts
  * monitoring the temperature and the humidity every 5 seconds.
  * Node4 provides a protection mechanism:
@@ -17,24 +18,38 @@
  * 			for 3 consecutive measurements, Node4 is switched off automatically
  * 			and CU is informed.
  * The green led on indicates that the steam room is on.
+ * Node4 also answers command 8 with its energy report: the CPU, LPM and radio
+ * time spent while the steam room is on and on each measurement (see energy.h),
+ * and command 9 with the trace of its last radio and process events (see
+ * trace.h).
  */
 
+#define HOME_NODE Node4
+
 #include "contiki.h"
-#include <stdio.h>
 #include "sys/etimer.h"
-#include "dev/sht11/sht11-sensor.h"
 #include "dev/button-sensor.h"
 #include "dev/leds.h"
 #include "net/rime/rime.h"
 #include "lib/random.h"
-
-#define MAX_RETRANSMISSIONS 5
+#include "message.h"
+#include "sht11-sampler.h"
+#include "energy.h"
+#include "home.h"
+#include "node.h"
+#include "transport.h"
+#include "serlog.h"
+#include "trace.h"
+#include "gesture.h"
+
+//longest wait for the second press of a double press
+#define DOUBLE_PRESS_TIME CLOCK_SECOND
 
 //steam room off by default (and no treatment selected)
 static int steam_room_on = 0;
 static int steam_room_treatment = 0; //=1 sauna; =2 steam bath
 
-//protection thresholds
+//protection thresholds (measurements are compared in tenths)
 static int MAX_TEMPERATURE_SAUNA = 80; //C
 static int MAX_HUMIDITY_SAUNA = 40; //%
 static int MAX_TEMPERATURE_STEAM_BATH = 50; //C
@@ -45,54 +60,66 @@ PROCESS(MeasurementProcess, "Temperature and humidity monitoring process");
 PROCESS(SwitchOffProcess, "Switch off process");
 PROCESS(TimeoutProcess, "Timer to switch sensor off");
 
-static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno) {
-	int* data = (int*)packetbuf_dataptr();
-	int command = *data;
-	printf("runicast message received from %d.%d, seqno %d\n", from->u8[0], from->u8[1], seqno);
-
-	if (command==6) {
-		steam_room_on = (steam_room_on==0)?1:0;
-
-		if (steam_room_on == 0) {
-			printf("Steam room is switching off...\n");
-			steam_room_treatment = 0;
-			leds_off(LEDS_GREEN);
-			process_exit(&TimeoutProcess);
-			process_exit(&MeasurementProcess);
-		} else {
-			printf("Steam room is switching on...\n");
-			leds_on(LEDS_GREEN);
-			process_start(&TimeoutProcess, NULL);
-			process_start(&MeasurementProcess, NULL);
-		}
+//command 6 of the CU, the only one of Node4
+static void handle_command(const struct msg_record *record, const linkaddr_t *from) {
+	if (record->code!=6)
+		return;
+
+	steam_room_on = (steam_room_on==0)?1:0;
+	if (steam_room_on == 0) {
+		serlog(LOG_STEAM_OFF);
+		steam_room_treatment = 0;
+		leds_off(LEDS_GREEN);
+		process_exit(&TimeoutProcess);
+		process_exit(&MeasurementProcess);
+		energy_end(ENERGY_SLOT_MEASUREMENT);
+		energy_end(ENERGY_SLOT_COMMAND(6));
+	} else {
+		serlog(LOG_STEAM_ON);
+		energy_begin(ENERGY_SLOT_COMMAND(6));
+		leds_on(LEDS_GREEN);
+		process_start(&TimeoutProcess, NULL);
+		process_start(&MeasurementProcess, NULL);
 	}
 }
 
-static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message sent to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+static struct gesture gesture;
+
+//the user has chosen the treatment with the button
+static void treatment_selected(uint8_t presses) {
+	if (steam_room_on==0)
+		return;
+	if (presses==1 || presses==2) {
+		steam_room_treatment = presses;
+
+		//inform the CU about the user's choice
+		msg_init(MSG_READING);
+		msg_add_int16(READING_TREATMENT, steam_room_treatment);
+		if (node_send(ENERGY_SLOTS))
+			serlog(LOG_SENDING_TREATMENT, steam_room_treatment, TRANSPORT_SINK, 0);
+	} else
+		serlog(LOG_COMMAND_NOT_FOUND);
 }
 
-static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
-	printf("runicast message timed out when sending to %d.%d, retransmissions %d\n", to->u8[0], to->u8[1], retransmissions);
+//an update replaces this file (see ota.h)
+static void exit_node(void) {
+	gesture_cancel(&gesture);
+	sht11_sampler_cancel(&MeasurementProcess);
 }
 
-static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
-static struct runicast_conn runicast;
-
 AUTOSTART_PROCESSES(&BaseProcess);
 
 PROCESS_THREAD(BaseProcess, ev, data) {
-	static struct etimer et_treatment;
-	PROCESS_EXITHANDLER(runicast_close(&runicast));
-
 	PROCESS_BEGIN();
 
-	static int button_presses = 0;
+	node_init(HOME_ADDR, HOME_CAPS, handle_command, exit_node);
 
-	//open runicast connection with CU
-	runicast_open(&runicast, 146, &runicast_calls);
+	sht11_sampler_init();
 
 	SENSORS_ACTIVATE(button_sensor);
+	//a double press (or a long press) is the steam bath
+	gesture_init(&gesture, &button_sensor, DOUBLE_PRESS_TIME, 2, treatment_selected);
+	gesture_set_valid(&gesture, (1<<1) | (1<<2));
 
 	while(1) {
 		PROCESS_WAIT_EVENT();
@@ -101,29 +128,9 @@ PROCESS_THREAD(BaseProcess, ev, data) {
 			if (steam_room_on == 0)
 				/* if steam room is off suppress the possibility to accept the
 				 button press command */
-				button_presses = 0;
-			else {
-				button_presses++;
-				etimer_set(&et_treatment, 3*CLOCK_SECOND);
-			}
-		} else if (etimer_expired(&et_treatment)) {
-			if (button_presses==1 || button_presses==2) {
-				steam_room_treatment = button_presses;
-
-				//inform the CU about the user's choice
-				if(!runicast_is_transmitting(&runicast)){
-					linkaddr_t recv;
-					recv.u8[0] = 3;
-					recv.u8[1] = 0;
-					packetbuf_copyfrom((void*)&steam_room_treatment, sizeof(int));
-					printf("Sending treatment %d to %d.%d\n", steam_room_treatment, recv.u8[0], recv.u8[1]);
-					runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-				}
-			} else {
-				if (steam_room_on == 1 && button_presses!=0)
-					printf("Command not found\n");
-			}
-			button_presses = 0;
+				gesture_cancel(&gesture);
+			else
+				gesture_press(&gesture);
 		}
 	}
 
@@ -132,20 +139,19 @@ PROCESS_THREAD(BaseProcess, ev, data) {
 
 PROCESS_THREAD(SwitchOffProcess, ev, data) {
 	PROCESS_BEGIN();
+	TRACE_BEGIN();
 
 	steam_room_on = 0;
 	steam_room_treatment = 0;
 	leds_off(LEDS_GREEN);
+	energy_end(ENERGY_SLOT_MEASUREMENT);
 
 	//inform the CU about the automatic switch off
-	if(!runicast_is_transmitting(&runicast)){
-		linkaddr_t recv;
-		recv.u8[0] = 3;
-		recv.u8[1] = 0;
-		packetbuf_copyfrom((void*)&steam_room_treatment, sizeof(int));
-		printf("Sending stop treatment to %d.%d\n", recv.u8[0], recv.u8[1]);
-		runicast_send(&runicast, &recv, MAX_RETRANSMISSIONS);
-	}
+	msg_init(MSG_READING);
+	msg_add_int16(READING_TREATMENT, steam_room_treatment);
+	if (node_send(ENERGY_SLOTS))
+		serlog(LOG_SENDING_STOP, TRANSPORT_SINK, 0);
+	energy_end(ENERGY_SLOT_COMMAND(6));
 
 	PROCESS_END();
 }
@@ -163,53 +169,55 @@ PROCESS_THREAD(MeasurementProcess, ev, data) {
 	static int count_temp_overcome_steam_bath = 0;
 	static int count_hum_overcome_steam_bath = 0;
 
+	TRACE_BEGIN();
 	etimer_set(&et_measurement, 5*CLOCK_SECOND);
 	while(1) {
 		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_measurement));
+		energy_begin(ENERGY_SLOT_MEASUREMENT);
+
+		//both values come from the same acquisition of the sampler
+		sht11_sampler_request(PROCESS_CURRENT(), SHT11_SAMPLER_TEMP | SHT11_SAMPLER_HUMIDITY);
+		PROCESS_WAIT_EVENT_UNTIL(ev==sht11_sampler_event);
 
-		SENSORS_ACTIVATE(sht11_sensor);
-		//adjust the sensed values
-		temp = (sht11_sensor.value(SHT11_SENSOR_TEMP)/10-396)/10;
-		hum = (0.0405*sht11_sensor.value(SHT11_SENSOR_HUMIDITY)-4)+
-				(-2.8*0.000001)*sht11_sensor.value(SHT11_SENSOR_HUMIDITY)*
-				sht11_sensor.value(SHT11_SENSOR_HUMIDITY);
-		SENSORS_DEACTIVATE(sht11_sensor);
+		//adjust the sensed values (tenths of C and tenths of %)
+		temp = sht11_sampler_temp();
+		hum = sht11_sampler_humidity();
 
 		/*	TEMPERATURE: add MAX_TEMP_SAUNA-24 or MAX_TEMP_STEAM_BATH-24 to
 		 	work next to the threshold
 			HUMIDITY: remove 116-MAX_HUM_SAUNA or 116-MAX_HUM_STEAM_BATH to
 			work next to the threshold
-			RANDOMIZE: as RANDOM_RAND_MAX=65535, random_rand()/6000 returns
-			approximately 10 values --> +/-5 C
+			RANDOMIZE: as RANDOM_RAND_MAX=65535, random_rand()/600 returns
+			approximately 100 values --> +/-5 C
 		*/
 		if (steam_room_treatment==1) {
-			temp = temp+(MAX_TEMPERATURE_SAUNA-24)+(int)random_rand()/6000;
-			hum = hum-(116-MAX_HUMIDITY_SAUNA)+(int)random_rand()/6000;
+			temp = temp+(MAX_TEMPERATURE_SAUNA-24)*10+(int)random_rand()/600;
+			hum = hum-(116-MAX_HUMIDITY_SAUNA)*10+(int)random_rand()/600;
 		} else if (steam_room_treatment==2) {
-			temp = temp+(MAX_TEMPERATURE_STEAM_BATH-24)+(int)random_rand()/6000;
-			hum = hum-(116-MAX_HUMIDITY_STEAM_BATH)+(int)random_rand()/6000;
+			temp = temp+(MAX_TEMPERATURE_STEAM_BATH-24)*10+(int)random_rand()/600;
+			hum = hum-(116-MAX_HUMIDITY_STEAM_BATH)*10+(int)random_rand()/600;
 		}
 
 		if (steam_room_treatment!=0)
-			printf("Sensed temperature: %d C; sensed humidity: %d%%\n", temp, hum);
+			serlog(LOG_STEAM_SENSED, temp, hum);
 
 		if (steam_room_treatment==1) { //sauna
 			count_temp_overcome_steam_bath = 0;
 			count_hum_overcome_steam_bath = 0;
-			if (temp > MAX_TEMPERATURE_SAUNA) {
+			if (temp > MAX_TEMPERATURE_SAUNA*10) {
 				count_temp_overcome_sauna++;
 				if (count_temp_overcome_sauna==3) {
-					printf("Temperature is too high!\nSteam room is switching off...\n\n");
+					serlog(LOG_STEAM_TOO_HOT);
 					process_exit(&TimeoutProcess);
 					process_start(&SwitchOffProcess, NULL);
 					PROCESS_EXIT();
 				}
 			} else
 				count_temp_overcome_sauna = 0;
-			if (hum > MAX_HUMIDITY_SAUNA) {
+			if (hum > MAX_HUMIDITY_SAUNA*10) {
 				count_hum_overcome_sauna++;
 				if (count_hum_overcome_sauna==3) {
-					printf("Humidity is too high!\nSteam room is switching off...\n\n");
+					serlog(LOG_STEAM_TOO_HUMID);
 					process_exit(&TimeoutProcess);
 					process_start(&SwitchOffProcess, NULL);
 					PROCESS_EXIT();
@@ -219,20 +227,20 @@ PROCESS_THREAD(MeasurementProcess, ev, data) {
 		} else if (steam_room_treatment==2) { //steam bath
 			count_temp_overcome_sauna = 0;
 			count_hum_overcome_sauna = 0;
-			if (temp > MAX_TEMPERATURE_STEAM_BATH) {
+			if (temp > MAX_TEMPERATURE_STEAM_BATH*10) {
 				count_temp_overcome_steam_bath++;
 				if (count_temp_overcome_steam_bath==3) {
-					printf("Temperature is too high!\nSteam room is switching off...\n\n");
+					serlog(LOG_STEAM_TOO_HOT);
 					process_exit(&TimeoutProcess);
 					process_start(&SwitchOffProcess, NULL);
 					PROCESS_EXIT();
 				}
 			} else
 				count_temp_overcome_steam_bath = 0;
-			if (hum > MAX_HUMIDITY_STEAM_BATH) {
+			if (hum > MAX_HUMIDITY_STEAM_BATH*10) {
 				count_hum_overcome_steam_bath++;
 				if (count_hum_overcome_steam_bath==3) {
-					printf("Humidity is too high!\nSteam room is switching off...\n\n");
+					serlog(LOG_STEAM_TOO_HUMID);
 					process_exit(&TimeoutProcess);
 					process_start(&SwitchOffProcess, NULL);
 					PROCESS_EXIT();
@@ -241,6 +249,7 @@ PROCESS_THREAD(MeasurementProcess, ev, data) {
 				count_hum_overcome_steam_bath = 0;
 		}
 
+		energy_end(ENERGY_SLOT_MEASUREMENT);
 		etimer_reset(&et_measurement);
 	}
 
@@ -250,10 +259,11 @@ PROCESS_THREAD(MeasurementProcess, ev, data) {
 PROCESS_THREAD(TimeoutProcess, ev, data) {
 	static struct etimer et_timeout;
 	PROCESS_BEGIN();
+	TRACE_BEGIN();
 
 	etimer_set(&et_timeout, 60*CLOCK_SECOND);
 	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et_timeout));
-	printf("\nTimer expired!\nSteam room is switching off...\n\n");
+	serlog(LOG_STEAM_TIMEOUT);
 	process_exit(&MeasurementProcess);
 	process_start(&SwitchOffProcess, NULL);
 
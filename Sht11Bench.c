@@ -0,0 +1,69 @@
+/*
+ * Benchmark of the SHT11 conversions, meant to run on a sky mote in Cooja
+ * (sht11-bench.csc, "make Sht11Bench.sky TARGET=sky").
+ *
+ * The old double-based formulas of Node1/Node4 and the integer kernels of
+ * sht11-conv.c are run BENCH_ITERATIONS times each. The firmware reports the
+ * elapsed rtimer ticks, while the simulation script reads the exact number of
+ * CPU cycles of MSPSim at the BENCH start/end markers and prints the cycles
+ * per conversion of both versions.
+ */
+
+#include "contiki.h"
+#include <stdio.h>
+#include "sht11-conv.h"
+
+#define BENCH_ITERATIONS 100
+
+//volatile, so that the compiler cannot precompute the conversions
+static volatile uint16_t raw_temp = 6500;
+static volatile uint16_t raw_hum = 1500;
+static volatile int sink;
+
+PROCESS(BenchProcess, "SHT11 conversion benchmark");
+
+AUTOSTART_PROCESSES(&BenchProcess);
+
+static int old_temp(uint16_t raw) {
+	return (raw/10-396)/10;
+}
+
+static int old_humidity(uint16_t raw) {
+	return (0.0405*raw-4)+(-2.8*0.000001)*raw*raw;
+}
+
+PROCESS_THREAD(BenchProcess, ev, data) {
+	static struct etimer et;
+	rtimer_clock_t start, end;
+	int i;
+
+	PROCESS_BEGIN();
+
+	//let the boot messages go out first
+	etimer_set(&et, CLOCK_SECOND);
+	PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+
+	printf("BENCH old start\n");
+	start = RTIMER_NOW();
+	for (i=0; i<BENCH_ITERATIONS; i++) {
+		sink = old_temp(raw_temp);
+		sink = old_humidity(raw_hum);
+	}
+	end = RTIMER_NOW();
+	printf("BENCH old end\n");
+	printf("old: %u rtimer ticks for %d conversions\n", (unsigned)(end-start), BENCH_ITERATIONS);
+
+	printf("BENCH fixed start\n");
+	start = RTIMER_NOW();
+	for (i=0; i<BENCH_ITERATIONS; i++) {
+		sink = sht11_conv_temp(raw_temp);
+		sink = sht11_conv_humidity(raw_hum);
+	}
+	end = RTIMER_NOW();
+	printf("BENCH fixed end\n");
+	printf("fixed: %u rtimer ticks for %d conversions\n", (unsigned)(end-start), BENCH_ITERATIONS);
+
+	printf("BENCH done %d\n", BENCH_ITERATIONS);
+
+	PROCESS_END();
+}
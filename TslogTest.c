@@ -0,0 +1,77 @@
+/*
+ * Test of the time-series log on Coffee, meant to run on a sky mote in Cooja
+ * (tslog-test.csc, "make TslogTest.sky TARGET=sky").
+ *
+ * The log is written until it ends with a record of an unchanged value (dv=0),
+ * reopened as at a reboot, written again and reopened once more; the export of
+ * the whole log must then give back every sample in order. Coffee finds the end
+ * of a file by skipping its trailing zeros, so a record ending with 0 would be
+ * cut by the reopening and overwritten by the next append (see tslog.h).
+ */
+
+#include "contiki.h"
+#include <stdio.h>
+#include "cfs/cfs.h"
+#include "tslog.h"
+
+#define TEST_LOG "ttest"
+
+//the first run ends with unchanged values, the second one with changes
+static const int16_t samples[] = {215, 215, 215, 215, 215, 215, 230, 231, 229, 229, 0, -3};
+#define SAMPLES (sizeof(samples)/sizeof(samples[0]))
+#define FIRST_RUN 6
+
+PROCESS(TslogTestProcess, "tslog test");
+
+AUTOSTART_PROCESSES(&TslogTestProcess);
+
+PROCESS_THREAD(TslogTestProcess, ev, data) {
+	static struct etimer et;
+	static struct tslog_decoder d;
+	static uint8_t i;
+	static int offset, count, errors;
+	uint8_t buf[32];
+	int len, j;
+
+	PROCESS_BEGIN();
+
+	cfs_remove(TEST_LOG ".0");
+	cfs_remove(TEST_LOG ".1");
+	tslog_init(TEST_LOG);
+
+	//one sample per second, so that consecutive samples are deltas
+	for (i=0; i<SAMPLES; i++) {
+		etimer_set(&et, CLOCK_SECOND);
+		PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+		tslog_append(samples[i]);
+		if (i==FIRST_RUN-1 || i==SAMPLES-1) {
+			//as at a reboot: the end of the log is found on flash again
+			tslog_flush();
+			tslog_init(TEST_LOG);
+		}
+	}
+
+	tslog_export_start(3600, 0);
+	tslog_decoder_init(&d, 1);
+	offset = count = errors = 0;
+	do {
+		len = tslog_export_read(offset, buf, sizeof(buf));
+		for (j=0; j<len; j++) {
+			if (!tslog_decode(&d, buf[j]))
+				continue;
+			if (count>=SAMPLES || d.value!=samples[count]) {
+				printf("TSLOG sample %d: %d\n", count, d.value);
+				errors++;
+			}
+			count++;
+		}
+		offset += len;
+	} while (len==sizeof(buf));
+
+	if (errors==0 && count==SAMPLES)
+		printf("TSLOG ok %d samples\n", count);
+	else
+		printf("TSLOG FAIL %d samples of %d, %d wrong\n", count, (int)SAMPLES, errors);
+
+	PROCESS_END();
+}
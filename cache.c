@@ -0,0 +1,69 @@
+/*
+ * Implementation of the reading cache (see cache.h). The table is tiny, so it
+ * is scanned linearly; when it is full the oldest entry is replaced.
+ */
+
+#include "cache.h"
+
+struct cache_entry {
+	linkaddr_t node;
+	uint8_t code;
+	uint8_t valid;
+	int16_t value;
+	unsigned long stamp; //clock_seconds(), clock_time() wraps too early on sky
+};
+
+static struct cache_entry entries[CACHE_SIZE];
+
+static struct cache_entry *lookup(const linkaddr_t *node, uint8_t code) {
+	int i;
+
+	for (i=0; i<CACHE_SIZE; i++) {
+		if (entries[i].valid && entries[i].code==code
+				&& linkaddr_cmp(&entries[i].node, node))
+			return &entries[i];
+	}
+	return NULL;
+}
+
+void cache_put(const linkaddr_t *node, uint8_t code, int16_t value) {
+	struct cache_entry *e = lookup(node, code);
+	int i;
+
+	if (e==NULL) {
+		//take a free entry or, if there is none, the oldest one
+		e = &entries[0];
+		for (i=0; i<CACHE_SIZE && e->valid; i++) {
+			if (!entries[i].valid || entries[i].stamp < e->stamp)
+				e = &entries[i];
+		}
+		linkaddr_copy(&e->node, node);
+		e->code = code;
+		e->valid = 1;
+	}
+
+	e->value = value;
+	e->stamp = clock_seconds();
+}
+
+int cache_get(const linkaddr_t *node, uint8_t code, unsigned long ttl,
+		int16_t *value, unsigned long *age) {
+	struct cache_entry *e = lookup(node, code);
+
+	if (e==NULL || clock_seconds()-e->stamp > ttl)
+		return 0;
+
+	*value = e->value;
+	if (age!=NULL)
+		*age = clock_seconds()-e->stamp;
+	return 1;
+}
+
+void cache_invalidate(const linkaddr_t *node) {
+	int i;
+
+	for (i=0; i<CACHE_SIZE; i++) {
+		if (linkaddr_cmp(&entries[i].node, node))
+			entries[i].valid = 0;
+	}
+}
@@ -0,0 +1,33 @@
+/*
+ * Cache of the latest readings received by the CU.
+ *
+ * Every entry is identified by the address of the node and by the reading
+ * code (READING_* in message.h) and carries the second it was received at. A
+ * query is answered from the cache while the entry is younger than the TTL
+ * chosen by the caller, so the radio is only used on a miss.
+ */
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+//number of readings remembered by the CU
+#ifdef CACHE_CONF_SIZE
+#define CACHE_SIZE CACHE_CONF_SIZE
+#else
+#define CACHE_SIZE 8
+#endif
+
+void cache_put(const linkaddr_t *node, uint8_t code, int16_t value);
+
+/* Returns 1 and fills value/age if the entry exists and is not older than
+ ttl (both in seconds). */
+int cache_get(const linkaddr_t *node, uint8_t code, unsigned long ttl,
+		int16_t *value, unsigned long *age);
+
+/* Forget all the readings of a node (e.g. after a command that changes them). */
+void cache_invalidate(const linkaddr_t *node);
+
+#endif /* CACHE_H_ */
@@ -0,0 +1,93 @@
+/*
+ * Implementation of the energy accounting (see energy.h).
+ */
+
+#include "energy.h"
+#include "message.h"
+#include "sys/energest.h"
+#include "sys/rtimer.h"
+
+static const uint8_t energest_types[ENERGY_QUANTITIES] = {ENERGEST_TYPE_CPU,
+		ENERGEST_TYPE_LPM, ENERGEST_TYPE_LISTEN, ENERGEST_TYPE_TRANSMIT};
+
+static struct {
+	unsigned long start[ENERGY_QUANTITIES]; //Energest time at energy_begin()
+	/*whole ms charged so far plus the rtimer ticks not yet converted, so that
+	 short intervals (a few ticks of CPU) are not rounded away*/
+	uint32_t ms[ENERGY_QUANTITIES];
+	uint16_t ticks[ENERGY_QUANTITIES];
+	uint8_t active;
+	uint8_t used;
+} slots[ENERGY_SLOTS];
+
+//convert the ticks of a slot to ms, keeping the remainder
+static uint32_t charge(uint32_t *ms, uint16_t *ticks, unsigned long elapsed) {
+	unsigned long t = *ticks+elapsed;
+	uint32_t total = *ms+(t/RTIMER_SECOND)*1000;
+
+	t %= RTIMER_SECOND;
+	*ms = total;
+	*ticks = t;
+	return total+(t*1000)/RTIMER_SECOND;
+}
+
+void energy_begin(uint8_t slot) {
+	int i;
+
+	if (slot>=ENERGY_SLOTS || slots[slot].active)
+		return;
+
+	//account for the time of the current CPU/radio state too
+	energest_flush();
+	for (i=0; i<ENERGY_QUANTITIES; i++)
+		slots[slot].start[i] = energest_type_time(energest_types[i]);
+	slots[slot].active = 1;
+	slots[slot].used = 1;
+}
+
+void energy_end(uint8_t slot) {
+	int i;
+
+	if (slot>=ENERGY_SLOTS || !slots[slot].active)
+		return;
+
+	energest_flush();
+	for (i=0; i<ENERGY_QUANTITIES; i++)
+		charge(&slots[slot].ms[i], &slots[slot].ticks[i],
+				energest_type_time(energest_types[i])-slots[slot].start[i]);
+	slots[slot].active = 0;
+}
+
+uint32_t energy_ms(uint8_t slot, uint8_t quantity) {
+	uint32_t ms;
+	uint16_t ticks;
+	unsigned long elapsed = 0;
+
+	if (slot>=ENERGY_SLOTS || quantity>=ENERGY_QUANTITIES)
+		return 0;
+
+	//a feature that is still running is charged up to now
+	if (slots[slot].active) {
+		energest_flush();
+		elapsed = energest_type_time(energest_types[quantity])-slots[slot].start[quantity];
+	}
+	ms = slots[slot].ms[quantity];
+	ticks = slots[slot].ticks[quantity];
+	return charge(&ms, &ticks, elapsed);
+}
+
+uint8_t energy_add_records(uint8_t mask) {
+	uint8_t value[ENERGY_RECORD_LEN];
+	uint8_t missing = 0;
+	int slot, i;
+
+	for (slot=0; slot<ENERGY_SLOTS; slot++) {
+		if (!(mask & (1<<slot)) || !slots[slot].used)
+			continue;
+		for (i=0; i<ENERGY_QUANTITIES; i++)
+			msg_put_uint32(&value[4*i], energy_ms(slot, i));
+		if (!msg_add(READING_ENERGY+slot, value, sizeof(value)))
+			missing |= 1<<slot;
+	}
+	return missing;
+}
@@ -0,0 +1,52 @@
+/*
+ * Energy accounting per feature, built on Energest.
+ *
+ * Every command (1..6) and every background task of a node has a slot. A slot
+ * is charged with the CPU, LPM, radio RX and radio TX time elapsed between
+ * energy_begin() and energy_end(), i.e. while the feature is active: the
+ * alarm slot covers the whole time the alarm is on, the slot of a query
+ * covers the request up to the end of the reply transmission. The intervals
+ * of features that are active at the same time overlap, so the slots show
+ * what each feature costs while it runs rather than a partition of the total.
+ *
+ * Times are accumulated in milliseconds (32 bits, about 49 days per slot) and
+ * sent to the CU as READING_ENERGY+slot records, one per slot that has been
+ * used at least once:
+ * 		msg_init(MSG_READING);
+ * 		energy_add_records(ENERGY_ALL);
+ */
+
+#ifndef ENERGY_H_
+#define ENERGY_H_
+
+#include "contiki.h"
+
+#define ENERGY_SLOT_COMMAND(n) ((n)-1)	//commands 1..6
+#define ENERGY_SLOT_TEMP 6				//TempProcess (Node1)
+#define ENERGY_SLOT_MEASUREMENT 7		//MeasurementProcess (Node4)
+#define ENERGY_SLOTS 8
+
+//argument of command 8: mask of the slots wanted in the report
+#define ENERGY_ALL 0xff
+
+//quantities of a slot, in the order they appear in a record
+#define ENERGY_CPU 0
+#define ENERGY_LPM 1
+#define ENERGY_RX 2
+#define ENERGY_TX 3
+#define ENERGY_QUANTITIES 4
+
+#define ENERGY_RECORD_LEN (4*ENERGY_QUANTITIES)
+
+/* Start/stop charging a slot (nested calls are ignored). */
+void energy_begin(uint8_t slot);
+void energy_end(uint8_t slot);
+
+/* Time charged to a slot so far (ms). */
+uint32_t energy_ms(uint8_t slot, uint8_t quantity);
+
+/* Add to the frame in the packetbuf the records of the used slots in mask.
+ Returns the mask of the slots that did not fit (0 if all of them did). */
+uint8_t energy_add_records(uint8_t mask);
+
+#endif /* ENERGY_H_ */
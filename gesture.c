@@ -0,0 +1,90 @@
+/*
+ * Implementation of the button gesture decoder (see gesture.h).
+ */
+
+#include "gesture.h"
+
+static uint8_t highest(uint16_t valid) {
+	uint8_t n = GESTURE_MAX_VALUE;
+
+	while (n>0 && !(valid & (1U<<n)))
+		n--;
+	return n;
+}
+
+static clock_time_t idle_timeout(const struct gesture *g) {
+	clock_time_t timeout = GESTURE_FACTOR*g->gap;
+
+	if (timeout<GESTURE_MIN_TIMEOUT)
+		timeout = GESTURE_MIN_TIMEOUT;
+	if (timeout>g->max_timeout)
+		timeout = g->max_timeout;
+	return timeout;
+}
+
+static void commit(struct gesture *g) {
+	uint8_t value = g->value;
+
+	ctimer_stop(&g->timer);
+	g->value = 0;
+	g->done(value);
+}
+
+static void expired(void *ptr) {
+	struct gesture *g = ptr;
+	clock_time_t held;
+
+	//a button still held at the end of the timeout may be a long press
+	if (g->long_value>0 && !g->was_long && g->button->value(0)) {
+		held = clock_time()-g->last;
+		if (held<GESTURE_LONG) {
+			ctimer_set(&g->timer, GESTURE_LONG-held, expired, g);
+			return;
+		}
+		g->was_long = 1;
+		g->value += g->long_value-1;
+		if (g->value<highest(g->valid)) {
+			ctimer_set(&g->timer, idle_timeout(g), expired, g);
+			return;
+		}
+	}
+	commit(g);
+}
+
+void gesture_init(struct gesture *g, const struct sensors_sensor *button,
+		clock_time_t max_timeout, uint8_t long_value, void (*done)(uint8_t value)) {
+	g->button = button;
+	g->done = done;
+	g->max_timeout = max_timeout;
+	g->gap = max_timeout/GESTURE_FACTOR;
+	g->valid = 0xffff;
+	g->long_value = long_value;
+	g->value = 0;
+	g->was_long = 0;
+}
+
+void gesture_set_valid(struct gesture *g, uint16_t valid) {
+	g->valid = valid;
+}
+
+void gesture_press(struct gesture *g) {
+	clock_time_t now = clock_time();
+
+	//learn the rhythm of the user from the intervals between short presses
+	if (g->value>0 && !g->was_long)
+		g->gap = (3*g->gap+(now-g->last))/4;
+	g->last = now;
+	g->was_long = 0;
+
+	if (g->value<GESTURE_MAX_VALUE)
+		g->value++;
+	if (g->value>=highest(g->valid))
+		commit(g);
+	else
+		ctimer_set(&g->timer, idle_timeout(g), expired, g);
+}
+
+void gesture_cancel(struct gesture *g) {
+	ctimer_stop(&g->timer);
+	g->value = 0;
+}
@@ -0,0 +1,76 @@
+/*
+ * Button gesture decoder shared by the CU and Node4.
+ *
+ * The value of a gesture is its number of presses. Instead of waiting a fixed
+ * idle time after the last press, the decoder commits the value:
+ * 		-)	at once, when it reaches the highest valid value (gesture_set_valid()):
+ * 			with the alarm on the CU accepts command 1 only, so a single press
+ * 			is enough, and on Node4 the second press of a double press;
+ * 		-)	at once, when a long press (button still held after GESTURE_LONG)
+ * 			brings it to the highest valid value. A long press is worth
+ * 			long_value presses, so long commands can be entered quickly;
+ * 		-)	otherwise after an idle timeout adapted to the rhythm of the user:
+ * 			GESTURE_FACTOR times the average interval between two presses,
+ * 			bounded by GESTURE_MIN_TIMEOUT and the max_timeout of the decoder
+ * 			(also the timeout used until the first intervals are measured).
+ *
+ * The decoder runs on a ctimer of the process that calls gesture_press(), and
+ * done() is called in that process.
+ */
+
+#ifndef GESTURE_H_
+#define GESTURE_H_
+
+#include "contiki.h"
+#include "lib/sensors.h"
+
+//idle timeout in average intervals between two presses
+#ifdef GESTURE_CONF_FACTOR
+#define GESTURE_FACTOR GESTURE_CONF_FACTOR
+#else
+#define GESTURE_FACTOR 2
+#endif
+
+//shortest idle timeout, longer than the debounce time of the button (1/4 s)
+#ifdef GESTURE_CONF_MIN_TIMEOUT
+#define GESTURE_MIN_TIMEOUT GESTURE_CONF_MIN_TIMEOUT
+#else
+#define GESTURE_MIN_TIMEOUT (CLOCK_SECOND/2)
+#endif
+
+//a press is long when the button is still held this long after it
+#ifdef GESTURE_CONF_LONG
+#define GESTURE_LONG GESTURE_CONF_LONG
+#else
+#define GESTURE_LONG (3*CLOCK_SECOND/4)
+#endif
+
+//highest value of a gesture
+#define GESTURE_MAX_VALUE 15
+
+struct gesture {
+	const struct sensors_sensor *button;
+	void (*done)(uint8_t value);
+	struct ctimer timer;
+	clock_time_t max_timeout;
+	clock_time_t gap;		//average interval between two presses
+	clock_time_t last;		//time of the last press
+	uint16_t valid;			//bit n set if n is a valid value
+	uint8_t long_value;		//value of a long press, 0 if not used
+	uint8_t value;			//value entered so far
+	uint8_t was_long;		//the last press is a long one
+};
+
+void gesture_init(struct gesture *g, const struct sensors_sensor *button,
+		clock_time_t max_timeout, uint8_t long_value, void (*done)(uint8_t value));
+
+/* Valid values (bit n for value n), all of them by default. */
+void gesture_set_valid(struct gesture *g, uint16_t valid);
+
+/* Call for every press of the button (sensors_event). */
+void gesture_press(struct gesture *g);
+
+/* Forget the presses of the gesture in progress. */
+void gesture_cancel(struct gesture *g);
+
+#endif /* GESTURE_H_ */
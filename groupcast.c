@@ -0,0 +1,249 @@
+/*
+ * Implementation of the reliable group commands (see groupcast.h).
+ */
+
+#include "groupcast.h"
+#include "message.h"
+#include "registry.h"
+#include "lib/random.h"
+#include "serlog.h"
+#include "trace.h"
+
+//seconds after which a node forgets a command (a rebooted CU reuses seqnos)
+#define HISTORY_LIFETIME 60
+
+static const struct groupcast_callbacks *callbacks;
+static struct broadcast_conn broadcast;
+static struct unicast_conn unicast;
+static uint16_t channel;
+
+//CU: group commands waiting for acknowledgements
+static struct group {
+	struct queuebuf *frame; //NULL if the group is free
+	struct ctimer timer;
+	linkaddr_t members[GROUPCAST_MEMBERS];
+	uint8_t count;
+	uint16_t acked; //bit i set when members[i] has acknowledged
+	uint8_t command;
+	uint8_t seqno;
+	uint8_t urgent;
+	uint8_t retries;
+	clock_time_t start;
+} groups[GROUPCAST_GROUPS];
+
+//node: last commands received, to execute the retransmissions only once
+static struct {
+	linkaddr_t from;
+	uint8_t seqno;
+	unsigned long time; //clock_seconds()
+} history[GROUPCAST_HISTORY];
+static uint8_t next_history = 0;
+
+//node: acknowledgement of a broadcast, sent after a random delay
+static struct ctimer ack_timer;
+static linkaddr_t ack_to;
+static uint8_t ack_seqno;
+static uint8_t ack_pending = 0;
+
+static void finish(struct group *g) {
+	uint8_t acked = 0;
+	int i;
+
+	ctimer_stop(&g->timer);
+	for (i=0; i<g->count; i++) {
+		if (g->acked & (1U<<i))
+			acked++;
+		else {
+			TRACE_ERROR(TRACE_TIMEOUT, g->members[i].u8[0], g->retries);
+			serlog(LOG_NO_ACK, g->command,
+					g->members[i].u8[0], g->members[i].u8[1]);
+		}
+	}
+	queuebuf_free(g->frame);
+	g->frame = NULL;
+	callbacks->done(g->command, acked, g->count,
+			(unsigned long)(clock_time_t)(clock_time()-g->start)*1000/CLOCK_SECOND);
+}
+
+//send the frame again, in unicast, to the members that have not answered
+static void retransmit(void *ptr) {
+	struct group *g = ptr;
+	int i;
+
+	if (g->retries>=GROUPCAST_RETRIES) {
+		finish(g);
+		return;
+	}
+	g->retries++;
+	for (i=0; i<g->count; i++) {
+		if (!(g->acked & (1U<<i))) {
+			queuebuf_to_packetbuf(g->frame);
+			if (callbacks->prepare!=NULL)
+				callbacks->prepare(clock_time()-g->start);
+			TRACE_ERROR(TRACE_RETRANSMISSION, g->members[i].u8[0], g->retries);
+			unicast_send(&unicast, &g->members[i]);
+		}
+	}
+	ctimer_set(&g->timer, GROUPCAST_TIMEOUT, retransmit, g);
+}
+
+int groupcast_send(uint16_t caps, int urgent) {
+	struct msg_reader reader;
+	struct msg_record record;
+	struct registry_node *n;
+	struct group *g = NULL;
+	int i;
+
+	if (msg_open(&reader)!=MSG_COMMAND || !msg_next(&reader, &record)
+			|| registry_first(caps)==NULL)
+		return 0;
+
+	for (i=0; i<GROUPCAST_GROUPS && g==NULL; i++) {
+		if (groups[i].frame==NULL)
+			g = &groups[i];
+	}
+	if (g==NULL && urgent) {
+		//give up the oldest command that is not urgent
+		for (i=0; i<GROUPCAST_GROUPS; i++) {
+			if (!groups[i].urgent && (g==NULL
+					|| clock_time()-groups[i].start > clock_time()-g->start))
+				g = &groups[i];
+		}
+		if (g!=NULL)
+			finish(g);
+	}
+	if (g==NULL || (g->frame = queuebuf_new_from_packetbuf())==NULL)
+		return -1;
+
+	g->count = 0;
+	for (n=registry_first(caps); n!=NULL && g->count<GROUPCAST_MEMBERS; n=registry_next(n, caps))
+		linkaddr_copy(&g->members[g->count++], &n->addr);
+	g->acked = 0;
+	g->command = record.code;
+	g->seqno = reader.seqno;
+	g->urgent = urgent;
+	g->retries = 0;
+	g->start = clock_time();
+
+	if (callbacks->prepare!=NULL)
+		callbacks->prepare(0);
+	TRACE_RADIO(TRACE_TX, 0, channel);
+	broadcast_send(&broadcast);
+	if (n!=NULL)
+		serlog(LOG_GROUP_TRUNCATED, g->command, g->count);
+	ctimer_set(&g->timer, GROUPCAST_TIMEOUT, retransmit, g);
+	return g->count;
+}
+
+static void recv_ack(const linkaddr_t *from) {
+	struct msg_reader reader;
+	struct msg_record record;
+	struct group *g;
+	int i;
+
+	//one record per acknowledged command, whose code is the seqno
+	if (msg_open(&reader)!=MSG_ACK)
+		return;
+	while (msg_next(&reader, &record)) {
+		for (g=groups; g<&groups[GROUPCAST_GROUPS]; g++) {
+			if (g->frame==NULL || g->seqno!=record.code)
+				continue;
+			for (i=0; i<g->count; i++) {
+				if (linkaddr_cmp(&g->members[i], from))
+					g->acked |= 1U<<i;
+			}
+			if (g->acked==(uint16_t)((1UL<<g->count)-1))
+				finish(g);
+		}
+	}
+}
+
+static void send_ack(void *ptr) {
+	msg_init(MSG_ACK);
+	msg_add(ack_seqno, NULL, 0);
+	TRACE_RADIO(TRACE_TX, ack_to.u8[0], channel+1);
+	unicast_send(&unicast, &ack_to);
+	ack_pending = 0;
+}
+
+//returns 1 if the command has already been received (its ack was lost)
+static int duplicate(const linkaddr_t *from, uint8_t seqno) {
+	int i;
+
+	for (i=0; i<GROUPCAST_HISTORY; i++) {
+		if (history[i].seqno==seqno && linkaddr_cmp(&history[i].from, from)
+				&& clock_seconds()-history[i].time <= HISTORY_LIFETIME)
+			return 1;
+	}
+	linkaddr_copy(&history[next_history].from, from);
+	history[next_history].seqno = seqno;
+	history[next_history].time = clock_seconds();
+	next_history = (next_history+1)%GROUPCAST_HISTORY;
+	return 0;
+}
+
+static void recv_command(const linkaddr_t *from, int broadcasted) {
+	struct msg_reader reader;
+	linkaddr_t sender;
+
+	if (callbacks->recv==NULL || msg_open(&reader)!=MSG_COMMAND)
+		return;
+	//the command may reuse the packetbuf and the sender address
+	linkaddr_copy(&sender, from);
+	if (!duplicate(&sender, reader.seqno))
+		callbacks->recv(&sender);
+
+	if (ack_pending) {
+		ctimer_stop(&ack_timer);
+		send_ack(NULL);
+	}
+	linkaddr_copy(&ack_to, &sender);
+	ack_seqno = reader.seqno;
+	ack_pending = 1;
+	if (broadcasted)
+		ctimer_set(&ack_timer, random_rand()%GROUPCAST_ACK_JITTER, send_ack, NULL);
+	else
+		send_ack(NULL);
+}
+
+static void recv_broadcast(struct broadcast_conn *c, const linkaddr_t *from) {
+	serlog(LOG_BROADCAST_RECV, from->u8[0], from->u8[1]);
+	TRACE_RADIO(TRACE_RX, from->u8[0], channel);
+	recv_command(from, 1);
+}
+
+static void recv_unicast(struct unicast_conn *c, const linkaddr_t *from) {
+	struct msg_reader reader;
+
+	TRACE_RADIO(TRACE_RX, from->u8[0], channel+1);
+	if (msg_open(&reader)==MSG_ACK)
+		recv_ack(from);
+	else
+		recv_command(from, 0);
+}
+
+static const struct broadcast_callbacks broadcast_calls = {recv_broadcast, NULL};
+static const struct unicast_callbacks unicast_calls = {recv_unicast, NULL};
+
+void groupcast_open(uint16_t c, const struct groupcast_callbacks *cb) {
+	callbacks = cb;
+	channel = c;
+	broadcast_open(&broadcast, channel, &broadcast_calls);
+	unicast_open(&unicast, channel+1, &unicast_calls);
+}
+
+void groupcast_close(void) {
+	int i;
+
+	for (i=0; i<GROUPCAST_GROUPS; i++) {
+		if (groups[i].frame!=NULL) {
+			ctimer_stop(&groups[i].timer);
+			queuebuf_free(groups[i].frame);
+			groups[i].frame = NULL;
+		}
+	}
+	ctimer_stop(&ack_timer);
+	ack_pending = 0;
+	broadcast_close(&broadcast);
+	unicast_close(&unicast);
+}
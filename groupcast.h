@@ -0,0 +1,101 @@
+/*
+ * Reliable group commands: a broadcast acknowledged by every member.
+ *
+ * A plain broadcast is fire and forget, so when the alarm (command 1) or the
+ * guest entrance (command 3) is lost by one node, that node stays out of step
+ * with the others. With groupcast the CU broadcasts the frame once to all the
+ * registered nodes having the capabilities of the command (see registry.h),
+ * and every node answers with a MSG_ACK frame in unicast. After
+ * GROUPCAST_TIMEOUT the frame is sent again, in unicast, only to the members
+ * that have not acknowledged it yet, up to GROUPCAST_RETRIES times. When every
+ * member has answered (or the retries are exhausted) the done callback tells
+ * the CU how long the whole group took to confirm.
+ *
+ * Retransmissions carry the same frame, so a node that receives a command
+ * twice (its acknowledgement was lost) acknowledges it again but executes it
+ * only once: command 1 toggles the alarm and must not be applied twice.
+ *
+ * The broadcast uses the channel given to groupcast_open(), the unicast
+ * retransmissions and the acknowledgements use the next one. Broadcasts do not
+ * cross the hops: in multi-hop mode (see transport.h) the CU keeps sending the
+ * group commands in unicast over the transport, which acknowledges every node.
+ */
+
+#ifndef GROUPCAST_H_
+#define GROUPCAST_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "registry.h"
+
+//group commands the CU keeps track of at the same time
+#ifdef GROUPCAST_CONF_GROUPS
+#define GROUPCAST_GROUPS GROUPCAST_CONF_GROUPS
+#else
+#define GROUPCAST_GROUPS 2
+#endif
+
+/*nodes a group command waits for (at most 16): every node of the registry by
+ default, a smaller group leaves the other nodes out (they still receive the
+ broadcast) and is logged*/
+#ifdef GROUPCAST_CONF_MEMBERS
+#define GROUPCAST_MEMBERS GROUPCAST_CONF_MEMBERS
+#else
+#define GROUPCAST_MEMBERS REGISTRY_SIZE
+#endif
+#if GROUPCAST_MEMBERS>16
+#error "at most 16 members per group command: set GROUPCAST_CONF_MEMBERS"
+#endif
+
+//time to wait for the acknowledgements before retransmitting
+#ifdef GROUPCAST_CONF_TIMEOUT
+#define GROUPCAST_TIMEOUT GROUPCAST_CONF_TIMEOUT
+#else
+#define GROUPCAST_TIMEOUT (CLOCK_SECOND/2)
+#endif
+
+//unicast retransmission rounds to the nodes that have not answered
+#ifdef GROUPCAST_CONF_RETRIES
+#define GROUPCAST_RETRIES GROUPCAST_CONF_RETRIES
+#else
+#define GROUPCAST_RETRIES 4
+#endif
+
+/*maximum random delay of the acknowledgement of a broadcast, so that the
+ nodes do not all answer at the same time*/
+#ifdef GROUPCAST_CONF_ACK_JITTER
+#define GROUPCAST_ACK_JITTER GROUPCAST_CONF_ACK_JITTER
+#else
+#define GROUPCAST_ACK_JITTER (CLOCK_SECOND/8)
+#endif
+
+//frames remembered by a node to recognize the retransmissions
+#ifdef GROUPCAST_CONF_HISTORY
+#define GROUPCAST_HISTORY GROUPCAST_CONF_HISTORY
+#else
+#define GROUPCAST_HISTORY 4
+#endif
+
+struct groupcast_callbacks {
+	/* Node: a new group command is in the packetbuf. */
+	void (*recv)(const linkaddr_t *from);
+	/* CU: the group command has been confirmed by acked of its members
+	 (acked<members if the retries are exhausted), elapsed ms after
+	 groupcast_send(). */
+	void (*done)(uint8_t command, uint8_t acked, uint8_t members,
+			unsigned long elapsed);
+	/* CU, optional: the frame is in the packetbuf and is about to be
+	 transmitted, elapsed clock ticks after groupcast_send() (see sched.h). */
+	void (*prepare)(clock_time_t elapsed);
+};
+
+void groupcast_open(uint16_t channel, const struct groupcast_callbacks *callbacks);
+void groupcast_close(void);
+
+/* CU: send the command frame in the packetbuf to every registered node having
+ the given capabilities. An urgent command takes the place of the oldest
+ pending one if all the groups are in use. Returns the number of members, 0 if
+ no node has the capabilities, -1 if there is no free group. */
+int groupcast_send(uint16_t caps, int urgent);
+
+#endif /* GROUPCAST_H_ */
@@ -0,0 +1,58 @@
+#!/usr/bin/env python3
+#
+# ROM/RAM report of the firmware images against the budgets of home.h, e.g.:
+#
+#	make budget TARGET=sky
+#	./home-budget.py CentralUnit.sky Node1.sky Node2.sky Node4.sky
+#
+# ROM is text+data (the initial values of the data are in flash), RAM is
+# data+bss; the stack grows in the rest of the RAM. The budgets are those of
+# the sky motes, so the images of the other targets are reported without a
+# check. The exit status is 1 if an image is over its budget.
+
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+def load_budgets(path):
+	budgets = {}
+	with open(path) as f:
+		for line in f:
+			m = re.match(r'\s*#define\s+HOME_(ROM|RAM)_(\w+)\s+(\d+)', line)
+			if m:
+				budgets.setdefault(m.group(2), {})[m.group(1)] = int(m.group(3))
+	return budgets
+
+def image_size(size, image):
+	out = subprocess.run([size, image], check=True, stdout=subprocess.PIPE,
+			universal_newlines=True).stdout.splitlines()
+	text, data, bss = (int(v) for v in out[1].split()[:3])
+	return text+data, data+bss
+
+def column(used, budget):
+	if budget is None:
+		return '%7d %7s %4s' % (used, '-', '')
+	return '%7d %7d %3d%%%s' % (used, budget, 100*used//budget,
+			' OVER' if used > budget else '')
+
+def main():
+	here = os.path.dirname(os.path.abspath(__file__))
+	budgets = load_budgets(os.path.join(here, 'home.h'))
+	size = shutil.which('msp430-size') or 'size'
+	over = False
+
+	print('%-12s %7s %7s %4s   %7s %7s' % ('image', 'ROM', 'budget', '', 'RAM', 'budget'))
+	for image in sys.argv[1:]:
+		name, target = os.path.splitext(os.path.basename(image))
+		rom, ram = image_size(size, image)
+		budget = budgets.get(name, {}) if target == '.sky' else {}
+		print('%-12s %s   %s' % (name, column(rom, budget.get('ROM')),
+				column(ram, budget.get('RAM'))))
+		over |= rom > budget.get('ROM', rom) or ram > budget.get('RAM', ram)
+
+	sys.exit(1 if over else 0)
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,57 @@
+/*
+ * Description of the house: the nodes, their Rime address, the commands they
+ * implement (capabilities, see registry.h) and the ROM/RAM budget of their
+ * firmware (bytes, checked by "make budget", see home-budget.py).
+ *
+ * Every node file defines HOME_NODE with its name before including this file
+ * and takes HOME_ADDR, HOME_CAPS, HOME_ROM and HOME_RAM from the block of that
+ * name. A node file only handles the commands of its HOME_CAPS, which it
+ * announces to the CU, and node_init() warns if the node does not have
+ * HOME_ADDR; the linker leaves out of its image the modules it never calls
+ * (see the Makefile). Moving a command to another node, or adding a node,
+ * only needs a new block here and a node file that implements the commands
+ * listed in it.
+ *
+ * Sensors and actuators of the nodes:
+ * 		CentralUnit	button, serial port (user interface)
+ * 		Node1		button (garden lights), LEDs, SHT11 (temperature), flash
+ * 		Node2		LEDs (gate), light sensor
+ * 		Node4		button (treatment), LEDs, SHT11 (temperature and humidity)
+ */
+
+#ifndef HOME_H_
+#define HOME_H_
+
+#include "registry.h"
+
+#define HOME_ADDR_CentralUnit 3
+#define HOME_CAPS_CentralUnit 0
+#define HOME_ROM_CentralUnit 46080
+#define HOME_RAM_CentralUnit 8192
+
+#define HOME_ADDR_Node1 1
+#define HOME_CAPS_Node1 (CAP_ALARM | CAP_GUEST | CAP_TEMP | CAP_ENERGY | CAP_TRACE)
+#define HOME_ROM_Node1 45056
+#define HOME_RAM_Node1 8192
+
+#define HOME_ADDR_Node2 2
+#define HOME_CAPS_Node2 (CAP_ALARM | CAP_GATE | CAP_GUEST | CAP_LIGHT | CAP_ENERGY | CAP_TRACE)
+#define HOME_ROM_Node2 40960
+#define HOME_RAM_Node2 7680
+
+#define HOME_ADDR_Node4 4
+#define HOME_CAPS_Node4 (CAP_STEAM | CAP_ENERGY | CAP_TRACE)
+#define HOME_ROM_Node4 36864
+#define HOME_RAM_Node4 7168
+
+#define HOME_CAT(a, b) HOME_CAT2(a, b)
+#define HOME_CAT2(a, b) a##b
+
+#ifdef HOME_NODE
+#define HOME_ADDR HOME_CAT(HOME_ADDR_, HOME_NODE)
+#define HOME_CAPS HOME_CAT(HOME_CAPS_, HOME_NODE)
+#define HOME_ROM HOME_CAT(HOME_ROM_, HOME_NODE)
+#define HOME_RAM HOME_CAT(HOME_RAM_, HOME_NODE)
+#endif
+
+#endif /* HOME_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Implementation of the LED patterns (see ledpat.h).
+ */
+
+#include "ledpat.h"
+#include "dev/leds.h"
+
+#define MAX_FRAMES 4
+
+/*longest sleep of the engine: the start of the endless patterns is moved
+ forward at every update, so that their phase never suffers a clock wrap*/
+#define MAX_SLEEP (60*CLOCK_SECOND)
+
+struct pattern {
+	unsigned char mask;			//LEDs driven by the pattern
+	uint8_t count;				//frames
+	clock_time_t frame_time;
+	unsigned char frames[MAX_FRAMES]; //LEDs on in every frame
+};
+
+static const struct pattern patterns[] = {
+	{LEDS_ALL, 2, CLOCK_SECOND, {0, LEDS_ALL}},		//LEDPAT_ALARM
+	{LEDS_BLUE, 2, CLOCK_SECOND, {0, LEDS_BLUE}},	//LEDPAT_GUEST
+};
+
+static struct {
+	const struct pattern *pattern; //NULL if the layer is off
+	clock_time_t start;
+	clock_time_t duration; //0 until ledpat_stop()
+} layers[LEDPAT_LAYERS];
+
+static unsigned char base;
+static struct ctimer timer;
+static void (*layer_done)(uint8_t layer);
+
+static void update(void *ptr) {
+	clock_time_t now = clock_time();
+	clock_time_t elapsed, period, wait = MAX_SLEEP;
+	unsigned char shown = base, hidden = 0, visible;
+	uint8_t expired = 0;
+	const struct pattern *p;
+	int i;
+
+	//from the highest layer: each one only shows the LEDs not taken above
+	for (i=LEDPAT_LAYERS-1; i>=0; i--) {
+		p = layers[i].pattern;
+		if (p==NULL)
+			continue;
+
+		elapsed = now-layers[i].start;
+		period = p->count*p->frame_time;
+		if (layers[i].duration>0) {
+			if (elapsed>=layers[i].duration) {
+				layers[i].pattern = NULL;
+				expired |= 1<<i;
+				continue;
+			}
+			if (layers[i].duration-elapsed < wait)
+				wait = layers[i].duration-elapsed;
+		} else if (elapsed>=period) {
+			layers[i].start += elapsed-elapsed%period;
+			elapsed %= period;
+		}
+
+		visible = p->mask & ~hidden;
+		shown = (shown & ~visible) | (p->frames[(elapsed/p->frame_time)%p->count] & visible);
+		//a hidden pattern needs no wake-up until it shows again
+		if (visible && p->frame_time-elapsed%p->frame_time < wait)
+			wait = p->frame_time-elapsed%p->frame_time;
+		hidden |= p->mask;
+	}
+
+	if (leds_get()!=shown)
+		leds_set(shown);
+
+	if (hidden)
+		ctimer_set(&timer, wait, update, NULL);
+	else
+		ctimer_stop(&timer);
+
+	for (i=0; i<LEDPAT_LAYERS; i++) {
+		if ((expired & (1<<i)) && layer_done!=NULL)
+			layer_done(i);
+	}
+}
+
+void ledpat_init(void (*done)(uint8_t layer)) {
+	int i;
+
+	layer_done = done;
+	for (i=0; i<LEDPAT_LAYERS; i++)
+		layers[i].pattern = NULL;
+	base = leds_get();
+	update(NULL);
+}
+
+void ledpat_start(uint8_t layer, uint8_t pattern, clock_time_t duration) {
+	layers[layer].pattern = &patterns[pattern];
+	layers[layer].start = clock_time();
+	layers[layer].duration = duration;
+	update(NULL);
+}
+
+void ledpat_stop(uint8_t layer) {
+	layers[layer].pattern = NULL;
+	update(NULL);
+}
+
+int ledpat_active(uint8_t layer) {
+	return layers[layer].pattern!=NULL;
+}
+
+void ledpat_on(unsigned char leds) {
+	base |= leds;
+	update(NULL);
+}
+
+void ledpat_off(unsigned char leds) {
+	base &= ~leds;
+	update(NULL);
+}
+
+void ledpat_toggle(unsigned char leds) {
+	base ^= leds;
+	update(NULL);
+}
+
+unsigned char ledpat_get(void) {
+	return base;
+}
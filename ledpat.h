@@ -0,0 +1,48 @@
+/*
+ * Table-driven LED patterns with layered priority, on a single ctimer.
+ *
+ * The LEDs shown are made of layers. The base layer holds the steady state
+ * set by the application (garden lights, gate) with ledpat_on(), ledpat_off()
+ * and ledpat_toggle(). Above it, every pattern layer plays one entry of the
+ * pattern table while it is active and hides the LEDs it drives from the
+ * layers below: the alarm (all the LEDs) hides the guest entrance blinking
+ * (blue LED), which hides the base layer. Stopping a layer simply uncovers
+ * the state below, so there is nothing to save and restore, and the base layer
+ * keeps following the application while it is hidden.
+ *
+ * The phase of a pattern is computed from its start time, so the engine only
+ * wakes up when a visible LED changes or a layer expires, instead of once per
+ * second per feature.
+ */
+
+#ifndef LEDPAT_H_
+#define LEDPAT_H_
+
+#include "contiki.h"
+
+//patterns of the table (ledpat.c)
+#define LEDPAT_ALARM 0	//all the LEDs, 2 s period, off first
+#define LEDPAT_GUEST 1	//blue LED, 2 s period, off first
+
+//pattern layers, from the lowest priority
+#define LEDPAT_LAYER_GUEST 0
+#define LEDPAT_LAYER_ALARM 1
+#define LEDPAT_LAYERS 2
+
+/* done() is called when a layer started with a duration expires (not when it
+ is stopped). */
+void ledpat_init(void (*done)(uint8_t layer));
+
+/* Play a pattern on a layer for duration clock ticks (< 512 s on sky), or
+ until ledpat_stop() if duration is 0. Restarts the layer if active. */
+void ledpat_start(uint8_t layer, uint8_t pattern, clock_time_t duration);
+void ledpat_stop(uint8_t layer);
+int ledpat_active(uint8_t layer);
+
+/* Base layer, same as the leds_*() functions of dev/leds.h. */
+void ledpat_on(unsigned char leds);
+void ledpat_off(unsigned char leds);
+void ledpat_toggle(unsigned char leds);
+unsigned char ledpat_get(void);
+
+#endif /* LEDPAT_H_ */
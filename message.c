@@ -0,0 +1,107 @@
+/*
+ * Encoding and decoding of the frames described in message.h.
+ */
+
+#include "message.h"
+#include "net/rime/rime.h"
+#include <string.h>
+
+static uint8_t seqno = 0;
+
+void msg_init(uint8_t type) {
+	struct msg_hdr *hdr;
+
+	packetbuf_clear();
+	hdr = (struct msg_hdr*)packetbuf_dataptr();
+	hdr->version = MSG_VERSION;
+	hdr->type = type;
+	hdr->seqno = seqno++;
+	hdr->len = 0;
+	packetbuf_set_datalen(sizeof(struct msg_hdr));
+}
+
+int msg_add(uint8_t code, const void *value, uint8_t len) {
+	struct msg_hdr *hdr = (struct msg_hdr*)packetbuf_dataptr();
+	uint8_t *pos;
+
+	if (hdr->len+2+len > MSG_MAX_LEN)
+		return 0;
+
+	pos = (uint8_t*)packetbuf_dataptr()+sizeof(struct msg_hdr)+hdr->len;
+	pos[0] = code;
+	pos[1] = len;
+	if (len>0)
+		memcpy(&pos[2], value, len);
+	hdr->len += 2+len;
+	packetbuf_set_datalen(sizeof(struct msg_hdr)+hdr->len);
+
+	return 1;
+}
+
+int msg_add_int16(uint8_t code, int16_t value) {
+	uint8_t buf[2];
+
+	buf[0] = (uint16_t)value & 0xff;
+	buf[1] = (uint16_t)value >> 8;
+	return msg_add(code, buf, 2);
+}
+
+int msg_open(struct msg_reader *r) {
+	const struct msg_hdr *hdr = (const struct msg_hdr*)packetbuf_dataptr();
+
+	if (packetbuf_datalen() < sizeof(struct msg_hdr)
+			|| hdr->version != MSG_VERSION
+			|| hdr->len > MSG_MAX_LEN
+			|| sizeof(struct msg_hdr)+hdr->len > packetbuf_datalen())
+		return 0;
+
+	r->type = hdr->type;
+	r->seqno = hdr->seqno;
+	r->pos = (const uint8_t*)packetbuf_dataptr()+sizeof(struct msg_hdr);
+	r->end = r->pos+hdr->len;
+
+	return r->type;
+}
+
+int msg_detach(struct msg_reader *r, uint8_t *buf, uint8_t size) {
+	uint8_t len = r->end-r->pos;
+
+	if (r->end-r->pos > size)
+		return 0;
+	memcpy(buf, r->pos, len);
+	r->pos = buf;
+	r->end = buf+len;
+	return 1;
+}
+
+int msg_next(struct msg_reader *r, struct msg_record *rec) {
+	if (r->end-r->pos < 2 || r->end-r->pos < 2+r->pos[1])
+		return 0;
+
+	rec->code = r->pos[0];
+	rec->len = r->pos[1];
+	rec->value = &r->pos[2];
+	r->pos += 2+rec->len;
+
+	return 1;
+}
+
+int16_t msg_int16(const struct msg_record *rec) {
+	if (rec->len==1)
+		return (int8_t)rec->value[0];
+	else if (rec->len>=2)
+		return (int16_t)(rec->value[0] | (rec->value[1] << 8));
+	return 0;
+}
+
+void msg_put_uint32(uint8_t *buf, uint32_t value) {
+	buf[0] = value & 0xff;
+	buf[1] = (value >> 8) & 0xff;
+	buf[2] = (value >> 16) & 0xff;
+	buf[3] = value >> 24;
+}
+
+uint32_t msg_get_uint32(const uint8_t *buf) {
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8)
+			| ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
@@ -0,0 +1,119 @@
+/*
+ * Binary message format shared by the CU and by all the nodes of the WSAN.
+ *
+ * Every frame starts with a packed 4-byte header (version, type, sequence
+ * number, payload length) followed by a list of records. Each record is made
+ * of a 1-byte code, a 1-byte length and the value itself, so that a single
+ * frame can carry several commands (or several readings) at once and the radio
+ * is used once per batch instead of once per value.
+ *
+ * Multi-byte values are always written byte by byte in little-endian order:
+ * the format does not depend on sizeof(int) (which differs between the sky and
+ * the native builds) and values are never accessed through unaligned pointers.
+ *
+ * Frames are built and parsed directly in the packetbuf:
+ * 		msg_init(MSG_COMMAND);
+ * 		msg_add(4, NULL, 0);
+ * 		runicast_send(...);
+ * and, in the receive callback:
+ * 		if (msg_open(&reader)==MSG_READING)
+ * 			while (msg_next(&reader, &record))
+ * 				...
+ */
+
+#ifndef MESSAGE_H_
+#define MESSAGE_H_
+
+#include "contiki.h"
+
+#define MSG_VERSION 1
+
+//maximum payload length, chosen to fit a 802.15.4 frame with Rime headers
+#ifdef MSG_CONF_MAX_LEN
+#define MSG_MAX_LEN MSG_CONF_MAX_LEN
+#else
+#define MSG_MAX_LEN 80
+#endif
+
+//frame types
+#define MSG_COMMAND 1	//record code = command number
+#define MSG_READING 2	//record code = one of the READING_* codes
+#define MSG_REPORT 3	//same as MSG_READING, but unsolicited (push mode)
+#define MSG_ACK 4		//record code = seqno of the acknowledged command (groupcast.h)
+
+//reading codes (temperatures in tenths of C, variance in hundredths of C^2)
+#define READING_TEMP_AVG 1
+#define READING_LIGHT 2
+#define READING_TREATMENT 3
+#define READING_TEMP_MIN 4
+#define READING_TEMP_MAX 5
+#define READING_TEMP_VAR 6
+#define READING_TEMP_COUNT 7
+#define READING_CAPS 8	//capabilities of the node (registry.h)
+#define READING_TRACE 9	//events of the trace ring (command 9, see trace.h)
+/*energy report (command 8): the code is READING_ENERGY+slot and the value
+ holds four uint32 in ms (see energy.h)*/
+#define READING_ENERGY 0x20
+
+//actions of the guest entrance schedule (command 3, see sched.h)
+#define ACTION_BLINK_ON 1	//start blinking the blue LED
+#define ACTION_BLINK_OFF 2	//stop blinking
+
+/*argument of command 4: mask of the temperature statistics wanted in the
+ reply (all of them come back in a single frame)*/
+#define TEMP_STATS_AVG 0x01
+#define TEMP_STATS_MIN 0x02
+#define TEMP_STATS_MAX 0x04
+#define TEMP_STATS_VAR 0x08
+#define TEMP_STATS_COUNT 0x10
+#define TEMP_STATS_ALL 0x1f
+
+struct msg_hdr {
+	uint8_t version;
+	uint8_t type;
+	uint8_t seqno;
+	uint8_t len; //payload length (records only, header excluded)
+} __attribute__((packed));
+
+struct msg_record {
+	uint8_t code;
+	uint8_t len;
+	const uint8_t *value;
+};
+
+struct msg_reader {
+	uint8_t type;
+	uint8_t seqno;
+	const uint8_t *pos;
+	const uint8_t *end;
+};
+
+/* Clear the packetbuf and write a new header of the given type. */
+void msg_init(uint8_t type);
+
+/* Append a record to the frame in the packetbuf. Returns 0 if it does not
+ fit. */
+int msg_add(uint8_t code, const void *value, uint8_t len);
+int msg_add_int16(uint8_t code, int16_t value);
+
+/* Validate the header of the frame in the packetbuf. Returns the frame type,
+ or 0 if the frame is malformed, longer than MSG_MAX_LEN or has a different
+ version. */
+int msg_open(struct msg_reader *r);
+
+/* Copy the records not read yet to buf (size bytes) and read them from there,
+ so that they survive the packetbuf being reused, e.g. by a reply. Returns 0,
+ and copies nothing, if they do not fit. */
+int msg_detach(struct msg_reader *r, uint8_t *buf, uint8_t size);
+
+/* Extract the next record. Returns 0 when there are no more records. */
+int msg_next(struct msg_reader *r, struct msg_record *rec);
+
+/* Decode the value of a record (1 or 2 bytes, sign extended). */
+int16_t msg_int16(const struct msg_record *rec);
+
+/* Little-endian helpers for the bodies made of several fields. */
+void msg_put_uint32(uint8_t *buf, uint32_t value);
+uint32_t msg_get_uint32(const uint8_t *buf);
+
+#endif /* MESSAGE_H_ */
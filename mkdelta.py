@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# Build the delta of an over-the-air update (see ota.h) from the module
+# installed on a node to the new one, e.g.:
+#
+#	make Node1.ce TARGET=sky OTA=1
+#	./mkdelta.py --node 1 old/Node1.ce Node1.ce Node1.delta
+#	./mkdelta.py --node 1 - Node1.ce Node1.delta	(first update, no module yet)
+#
+# The new image is rebuilt from copies of the old one and literal bytes: at
+# every position the longest match in the old image (found through an index of
+# its 4-byte sequences) is copied if it saves space, the rest goes as it is.
+# The sizes and the CRC16 (the one of Contiki's lib/crc16.c) of both images are
+# in the header, so the node can refuse a delta for another base or a corrupt
+# result.
+
+import argparse
+import struct
+import sys
+
+MIN_COPY = 4
+MAX_COPY = 0x7f+MIN_COPY
+MAX_LITERAL = 0x80
+MAX_CANDIDATES = 64		# positions tried for every 4-byte sequence
+
+def crc16(data, acc=0):
+	for b in data:
+		acc ^= b
+		acc = ((acc >> 8) | (acc << 8)) & 0xffff
+		acc ^= (acc & 0xff00) << 4
+		acc &= 0xffff
+		acc ^= (acc >> 8) >> 4
+		acc ^= (acc & 0xff00) >> 5
+	return acc
+
+def longest_match(old, new, pos, index):
+	best_len, best_off = 0, 0
+	for off in index.get(new[pos:pos+MIN_COPY], ()):
+		n = 0
+		while n < MAX_COPY and pos+n < len(new) and off+n < len(old) and old[off+n] == new[pos+n]:
+			n += 1
+		if n > best_len:
+			best_len, best_off = n, off
+	return best_len, best_off
+
+def delta_ops(old, new):
+	index = {}
+	for off in range(len(old)-MIN_COPY+1):
+		positions = index.setdefault(old[off:off+MIN_COPY], [])
+		if len(positions) < MAX_CANDIDATES:
+			positions.append(off)
+
+	ops = bytearray()
+	literal = bytearray()
+
+	def flush():
+		for i in range(0, len(literal), MAX_LITERAL):
+			chunk = literal[i:i+MAX_LITERAL]
+			ops.append(len(chunk)-1)
+			ops.extend(chunk)
+		del literal[:]
+
+	pos = 0
+	while pos < len(new):
+		n, off = longest_match(old, new, pos, index)
+		# a copy costs 3 bytes
+		if n >= MIN_COPY:
+			flush()
+			ops.append(0x80 | (n-MIN_COPY))
+			ops.extend(struct.pack('<H', off))
+			pos += n
+		else:
+			literal.append(new[pos])
+			pos += 1
+	flush()
+	return ops
+
+def main():
+	parser = argparse.ArgumentParser(description='Build the delta of an OTA update')
+	parser.add_argument('--node', type=int, default=0,
+			help='address of the node to update (0: every node)')
+	parser.add_argument('--version', type=int, default=0,
+			help='version of the module, 0-255, only informative')
+	parser.add_argument('old', help='module installed on the node, - for none')
+	parser.add_argument('new', help='new module')
+	parser.add_argument('delta', help='output')
+	args = parser.parse_args()
+
+	old = b'' if args.old == '-' else open(args.old, 'rb').read()
+	new = open(args.new, 'rb').read()
+	if len(old) > 0xffff or len(new) > 0xffff:
+		sys.exit('mkdelta: images larger than 64 KB')
+
+	delta = b'OD' + struct.pack('<BBHHHH', args.node, args.version & 0xff,
+			len(old), crc16(old), len(new), crc16(new)) + delta_ops(old, new)
+	with open(args.delta, 'wb') as f:
+		f.write(delta)
+	print('%s: %d bytes (new image %d bytes, %d%%)' % (args.delta, len(delta),
+			len(new), 100*len(delta)//max(len(new), 1)))
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,241 @@
+/*
+ * Radio stand-in for the native builds: the frames travel as UDP datagrams on
+ * the loopback interface, so the nodes of the house can run as processes of
+ * the same Linux host (see run-native.sh).
+ *
+ * Node a.b listens on port NATIVE_RADIO_PORT+a and every frame is sent to
+ * the ports of nodes 1 to NATIVE_RADIO_NODES: all the nodes are in range of
+ * each other, and the MAC layer discards the frames addressed to other nodes
+ * like on a real channel. The address of the node is taken from the NODE_ADDR
+ * environment variable ("3.0", or just "3"), and RADIO_LOSS sets the
+ * percentage of frames dropped on reception, to exercise the retransmissions.
+ *
+ * All the processes share the wall clock of the host (rtimer and clock of the
+ * native platform), so the timestamps of timesynch are simply the local time
+ * of departure and of arrival of the frame.
+ */
+
+#include "contiki.h"
+#include "dev/radio.h"
+#include "net/netstack.h"
+#include "net/packetbuf.h"
+#include "lib/random.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef NATIVE_RADIO_CONF_PORT
+#define NATIVE_RADIO_PORT NATIVE_RADIO_CONF_PORT
+#else
+#define NATIVE_RADIO_PORT 20000
+#endif
+
+//nodes 1.x to NATIVE_RADIO_NODES.x receive every frame
+#ifdef NATIVE_RADIO_CONF_NODES
+#define NATIVE_RADIO_NODES NATIVE_RADIO_CONF_NODES
+#else
+#define NATIVE_RADIO_NODES 8
+#endif
+
+#define MAX_FRAME 127
+
+static int sock = -1;
+static int listening = 1;
+static int loss;
+
+static uint8_t tx_frame[MAX_FRAME];
+static unsigned short tx_len;
+static uint8_t rx_frame[MAX_FRAME];
+static int rx_len; //0 when the frame has been delivered
+static rtimer_clock_t rx_time;
+
+PROCESS(native_radio_process, "Native radio");
+
+static int set_fd(fd_set *rset, fd_set *wset) {
+	//leave the next datagram in the socket until the last frame is delivered
+	if (sock<0 || rx_len>0)
+		return 0;
+	FD_SET(sock, rset);
+	return 1;
+}
+
+static void handle_fd(fd_set *rset, fd_set *wset) {
+	int len;
+
+	if (sock<0 || !FD_ISSET(sock, rset))
+		return;
+	len = recv(sock, rx_frame, sizeof(rx_frame), 0);
+	if (len<=0 || !listening || (loss>0 && random_rand()%100<loss))
+		return;
+	rx_time = RTIMER_NOW();
+	rx_len = len;
+	process_poll(&native_radio_process);
+}
+
+static const struct select_callback select_calls = {set_fd, handle_fd};
+
+static void set_node_addr(void) {
+	linkaddr_t addr;
+	const char *s = getenv("NODE_ADDR");
+	char *end;
+
+	if (s==NULL)
+		return;
+	linkaddr_copy(&addr, &linkaddr_null);
+	addr.u8[0] = strtoul(s, &end, 10);
+	if (*end=='.')
+		addr.u8[1] = strtoul(end+1, NULL, 10);
+	linkaddr_set_node_addr(&addr);
+}
+
+static int radio_init(void) {
+	struct sockaddr_in sin;
+	const char *s;
+
+	set_node_addr();
+	if ((s = getenv("RADIO_LOSS"))!=NULL)
+		loss = atoi(s);
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(NATIVE_RADIO_PORT+linkaddr_node_addr.u8[0]);
+	if (sock<0 || bind(sock, (struct sockaddr *)&sin, sizeof(sin))<0) {
+		perror("native radio");
+		exit(1);
+	}
+	select_set_callback(sock, &select_calls);
+
+	process_start(&native_radio_process, NULL);
+	return 1;
+}
+
+static int radio_prepare(const void *payload, unsigned short payload_len) {
+	if (payload_len>MAX_FRAME)
+		return 1;
+	memcpy(tx_frame, payload, payload_len);
+	tx_len = payload_len;
+	return 0;
+}
+
+static int radio_transmit(unsigned short transmit_len) {
+	struct sockaddr_in sin;
+	rtimer_clock_t now;
+	int i;
+
+#if PACKETBUF_WITH_PACKET_TYPE
+	//timesynch: the last 2 bytes carry the time of departure
+	if (packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE)==PACKETBUF_ATTR_PACKET_TYPE_TIMESTAMP
+			&& tx_len>=2) {
+		now = RTIMER_NOW();
+		tx_frame[tx_len-2] = now & 0xff;
+		tx_frame[tx_len-1] = (now >> 8) & 0xff;
+	}
+#endif
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	for (i=1; i<=NATIVE_RADIO_NODES; i++) {
+		if (i==linkaddr_node_addr.u8[0])
+			continue;
+		sin.sin_port = htons(NATIVE_RADIO_PORT+i);
+		sendto(sock, tx_frame, tx_len, 0, (struct sockaddr *)&sin, sizeof(sin));
+	}
+	return RADIO_TX_OK;
+}
+
+static int radio_send(const void *payload, unsigned short payload_len) {
+	if (radio_prepare(payload, payload_len))
+		return RADIO_TX_ERR;
+	return radio_transmit(payload_len);
+}
+
+static int radio_read(void *buf, unsigned short buf_len) {
+	int len = rx_len;
+
+	if (len>buf_len)
+		len = buf_len;
+	memcpy(buf, rx_frame, len);
+	rx_len = 0;
+	return len;
+}
+
+static int radio_channel_clear(void) {
+	return 1;
+}
+
+static int radio_receiving_packet(void) {
+	return 0;
+}
+
+static int radio_pending_packet(void) {
+	return rx_len>0;
+}
+
+static int radio_on(void) {
+	listening = 1;
+	return 1;
+}
+
+static int radio_off(void) {
+	listening = 0;
+	return 1;
+}
+
+static radio_result_t radio_get_value(radio_param_t param, radio_value_t *value) {
+	return RADIO_RESULT_NOT_SUPPORTED;
+}
+
+static radio_result_t radio_set_value(radio_param_t param, radio_value_t value) {
+	return RADIO_RESULT_NOT_SUPPORTED;
+}
+
+static radio_result_t radio_get_object(radio_param_t param, void *dest, size_t size) {
+	return RADIO_RESULT_NOT_SUPPORTED;
+}
+
+static radio_result_t radio_set_object(radio_param_t param, const void *src, size_t size) {
+	return RADIO_RESULT_NOT_SUPPORTED;
+}
+
+const struct radio_driver native_radio_driver = {
+	radio_init,
+	radio_prepare,
+	radio_transmit,
+	radio_send,
+	radio_read,
+	radio_channel_clear,
+	radio_receiving_packet,
+	radio_pending_packet,
+	radio_on,
+	radio_off,
+	radio_get_value,
+	radio_set_value,
+	radio_get_object,
+	radio_set_object
+};
+
+PROCESS_THREAD(native_radio_process, ev, data) {
+	int len;
+
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev==PROCESS_EVENT_POLL);
+		packetbuf_clear();
+		packetbuf_set_attr(PACKETBUF_ATTR_TIMESTAMP, rx_time);
+		len = radio_read(packetbuf_dataptr(), PACKETBUF_SIZE);
+		if (len>0) {
+			packetbuf_set_datalen(len);
+			NETSTACK_RDC.input();
+		}
+	}
+
+	PROCESS_END();
+}
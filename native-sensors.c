@@ -0,0 +1,93 @@
+/*
+ * Implementation of the sensor stand-ins of the native builds (see
+ * native-sensors.h).
+ */
+
+#include "native-sensors.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "dev/button-sensor.h"
+#include "lib/random.h"
+#include "sht11-conv.h"
+#include <signal.h>
+#include <stdlib.h>
+
+//raw readings, found with the conversions of the nodes
+static uint16_t raw_temp, raw_humidity, raw_light;
+static int sht11_active, light_active;
+
+//tenths of the variable, or the default
+static long env_tenths(const char *name, long def) {
+	const char *s = getenv(name);
+
+	return (s!=NULL)? (long)(atof(s)*10):def;
+}
+
+//smallest raw value converted to at least target, by bisection
+static uint16_t invert(int16_t (*conv)(uint16_t), int16_t target, uint16_t max) {
+	uint16_t low = 0, high = max;
+
+	while (low<high) {
+		uint16_t mid = low+(high-low)/2;
+		if (conv(mid)<target)
+			low = mid+1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+//uniform noise in [-amplitude, amplitude]
+static int noise(int amplitude) {
+	return (int)(random_rand()%(2*amplitude+1))-amplitude;
+}
+
+static void press_button(int sig) {
+	sensors_changed(&button_sensor);
+}
+
+/*read the environment and hook the button to SIGUSR1 when the process
+ starts: the native platform initialises no driver of the project*/
+static void __attribute__((constructor)) native_sensors_init(void) {
+	raw_temp = invert(sht11_conv_temp, env_tenths("SIM_TEMP", 240), 0x3fff);
+	//the humidity curve has its maximum above 12 bits
+	raw_humidity = invert(sht11_conv_humidity, env_tenths("SIM_HUMIDITY", 1160), 0xfff);
+	raw_light = env_tenths("SIM_LIGHT", 3000)*7/100;
+	signal(SIGUSR1, press_button);
+}
+
+static int sht11_value(int type) {
+	switch (type) {
+	case SHT11_SENSOR_TEMP:
+		return raw_temp+noise(20);
+	case SHT11_SENSOR_HUMIDITY:
+		return raw_humidity+noise(10);
+	}
+	return 0;
+}
+
+static int light_value(int type) {
+	return raw_light+noise(3);
+}
+
+static int sht11_configure(int type, int value) {
+	if (type==SENSORS_ACTIVE)
+		sht11_active = value;
+	return 1;
+}
+
+static int sht11_status(int type) {
+	return (type==SENSORS_ACTIVE || type==SENSORS_READY)? sht11_active:0;
+}
+
+static int light_configure(int type, int value) {
+	if (type==SENSORS_ACTIVE)
+		light_active = value;
+	return 1;
+}
+
+static int light_status(int type) {
+	return (type==SENSORS_ACTIVE || type==SENSORS_READY)? light_active:0;
+}
+
+SENSORS_SENSOR(sht11_sensor, "sht11", sht11_value, sht11_configure, sht11_status);
+SENSORS_SENSOR(light_sensor, "light", light_value, light_configure, light_status);
@@ -0,0 +1,24 @@
+/*
+ * Stand-ins of the sensors of the sky mote for the native builds.
+ *
+ * The SHT11 (dev/sht11/sht11-sensor.h) and the light sensor return raw
+ * readings around the values given in the environment, with a little noise:
+ * 		SIM_TEMP		temperature in C (default 24, like Cooja)
+ * 		SIM_HUMIDITY	relative humidity in % (default 116, like Cooja)
+ * 		SIM_LIGHT		photosynthetic light in lux (default 300)
+ * The button of the native platform is pressed by sending SIGUSR1 to the
+ * process (kill -USR1 <pid>).
+ */
+
+#ifndef NATIVE_SENSORS_H_
+#define NATIVE_SENSORS_H_
+
+#include "contiki.h"
+#include "lib/sensors.h"
+
+//same interface as dev/light-sensor.h of the sky platform
+extern const struct sensors_sensor light_sensor;
+#define LIGHT_SENSOR_PHOTOSYNTHETIC 0
+#define LIGHT_SENSOR_TOTAL_SOLAR 1
+
+#endif /* NATIVE_SENSORS_H_ */
@@ -0,0 +1,219 @@
+/*
+ * Implementation of the skeleton of the nodes (see node.h).
+ */
+
+#include "node.h"
+#include "energy.h"
+#include "registry.h"
+#include "transport.h"
+#include "groupcast.h"
+#include "sched.h"
+#include "ledpat.h"
+#include "serlog.h"
+#include "trace.h"
+#include "ota.h"
+
+static void (*node_command)(const struct msg_record *record, const linkaddr_t *from);
+static void (*node_exit)(void);
+//stops what node_open_group() has started, NULL if not opened
+static void (*group_exit)(void);
+static int alarm = 0;
+static uint8_t requested_energy;
+//energy slot charged until the unicast in progress is acknowledged
+static uint8_t reply_slot = ENERGY_SLOTS;
+
+//Command 8: send energy report
+PROCESS(SendEnergyProcess, "Send energy process");
+
+/*
+ * Execute the commands of the frame in the packetbuf. They come in acknowledged
+ * broadcast (1 and 3, executed once even if retransmitted, see groupcast.h) or
+ * in unicast, but in multi-hop mode the CU sends all of them in unicast, so
+ * both paths accept every command.
+ */
+static void handle_commands(const linkaddr_t *sender) {
+	struct msg_reader reader;
+	struct msg_record record;
+	uint8_t records[MSG_MAX_LEN];
+	linkaddr_t from;
+
+	if (msg_open(&reader)!=MSG_COMMAND)
+		return;
+#if WITH_LLSEC
+	//only the beacons of timesynch may come in clear (see secure-framer.c)
+	if (packetbuf_attr(PACKETBUF_ATTR_SECURITY_LEVEL)==0) {
+		serlog(LOG_COMMAND_IN_CLEAR, sender->u8[0], sender->u8[1]);
+		return;
+	}
+#endif
+
+	/*a frame may carry several commands: handle them in order, from a copy,
+	 since the commands that reply build their frame in the packetbuf*/
+	if (!msg_detach(&reader, records, sizeof(records)))
+		return;
+	linkaddr_copy(&from, sender);
+	while (msg_next(&reader, &record)) {
+		serlog(LOG_COMMAND, record.code);
+		if (record.code==8) {
+			requested_energy = (record.len>0)? record.value[0]:ENERGY_ALL;
+			process_start(&SendEnergyProcess, NULL);
+		} else if (record.code==9) {
+			linkaddr_t cu;
+			transport_sink(&cu);
+			trace_dump(&cu);
+		} else if (node_command!=NULL)
+			node_command(&record, &from);
+	}
+}
+
+static void recv_group(const linkaddr_t *from) {
+	handle_commands(from);
+}
+
+static void recv_unicast(const linkaddr_t *from, uint8_t seqno) {
+	serlog(LOG_UNICAST_RECV, from->u8[0], from->u8[1], seqno);
+	handle_commands(from);
+}
+
+static void sent_unicast(const linkaddr_t *to, uint8_t retransmissions) {
+	serlog(LOG_UNICAST_SENT, to->u8[0], to->u8[1], retransmissions);
+	energy_end(reply_slot);
+	reply_slot = ENERGY_SLOTS;
+}
+
+static void timedout_unicast(const linkaddr_t *to, uint8_t retransmissions) {
+	serlog(LOG_UNICAST_TIMEDOUT, to->u8[0], to->u8[1], retransmissions);
+	energy_end(reply_slot);
+	reply_slot = ENERGY_SLOTS;
+}
+
+static const struct groupcast_callbacks groupcast_calls = {recv_group, NULL, NULL};
+static const struct transport_callbacks transport_calls = {recv_unicast, sent_unicast, timedout_unicast};
+
+#if OTA_ENABLED
+//the node file is going to be replaced by an update
+static void exit_image(void) {
+	if (node_exit!=NULL)
+		node_exit();
+	if (group_exit!=NULL)
+		group_exit();
+	transport_close();
+	node_command = NULL;
+	node_exit = NULL;
+}
+#endif
+
+void node_init(uint8_t addr, uint16_t caps,
+		void (*command)(const struct msg_record *record, const linkaddr_t *from),
+		void (*exit)(void)) {
+	node_command = command;
+	node_exit = exit;
+
+	serlog_init();
+	trace_init();
+
+	//the CU would send to this node the commands of another one
+	if (linkaddr_node_addr.u8[0]!=addr || linkaddr_node_addr.u8[1]!=0)
+		serlog(LOG_WRONG_ADDR, linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], addr);
+
+	//open reliable connection with CU (shared with the other nodes)
+	transport_open(144, &transport_calls);
+
+	//let the CU know which commands this node implements
+	registry_announce(caps);
+
+#if OTA_ENABLED
+	//relay the updates, install the ones of this node (see ota.h)
+	ota_open(160, ota_install, exit_image);
+	ota_install();
+#endif
+}
+
+//Command 3: actions of the guest entrance schedule
+static void run_action(uint8_t action) {
+	if (action==ACTION_BLINK_ON)
+		ledpat_start(LEDPAT_LAYER_GUEST, LEDPAT_GUEST, 0);
+	else if (action==ACTION_BLINK_OFF) {
+		ledpat_stop(LEDPAT_LAYER_GUEST);
+		energy_end(ENERGY_SLOT_COMMAND(3));
+	}
+}
+
+//the blinking of command 3 without a schedule is over
+static void blinking_done(uint8_t layer) {
+	if (layer==LEDPAT_LAYER_GUEST)
+		energy_end(ENERGY_SLOT_COMMAND(3));
+}
+
+#if OTA_ENABLED
+static void close_group(void) {
+	groupcast_close();
+	sched_cancel();
+	ledpat_stop(LEDPAT_LAYER_GUEST);
+	ledpat_stop(LEDPAT_LAYER_ALARM);
+	alarm = 0;
+	energy_end(ENERGY_SLOT_COMMAND(1));
+	energy_end(ENERGY_SLOT_COMMAND(3));
+	group_exit = NULL;
+}
+#endif
+
+void node_open_group(void) {
+	//open the acknowledged broadcast connection with the CU
+	groupcast_open(129, &groupcast_calls);
+	sched_init(run_action);
+	ledpat_init(blinking_done);
+#if OTA_ENABLED
+	group_exit = close_group;
+#endif
+}
+
+int node_guest(const struct msg_record *record) {
+	energy_begin(ENERGY_SLOT_COMMAND(3));
+	//with a schedule the deadlines come from the CU, in network time
+	return record->len==0 || sched_load(record)==0;
+}
+
+int node_send(uint8_t slot) {
+	linkaddr_t cu;
+
+	if (transport_is_transmitting()) {
+		energy_end(slot);
+		return 0;
+	}
+	transport_sink(&cu);
+	transport_send(&cu, NODE_MAX_RETRANSMISSIONS);
+	reply_slot = slot;
+	return 1;
+}
+
+int node_alarm_toggle(void) {
+	//the alarm hides the other LEDs until it is deactivated
+	alarm = !alarm;
+	if (alarm) {
+		energy_begin(ENERGY_SLOT_COMMAND(1));
+		ledpat_start(LEDPAT_LAYER_ALARM, LEDPAT_ALARM, 0);
+	} else {
+		ledpat_stop(LEDPAT_LAYER_ALARM);
+		energy_end(ENERGY_SLOT_COMMAND(1));
+	}
+	return alarm;
+}
+
+int node_alarm_on(void) {
+	return alarm;
+}
+
+PROCESS_THREAD(SendEnergyProcess, ev, data) {
+	PROCESS_BEGIN();
+	TRACE_BEGIN();
+
+	//transmit the energy report to the CU, as many slots as fit in a frame
+	msg_init(MSG_READING);
+	if (energy_add_records(requested_energy))
+		serlog(LOG_ENERGY_TRUNCATED);
+	if (node_send(ENERGY_SLOTS))
+		serlog(LOG_SENDING_ENERGY, TRANSPORT_SINK, 0);
+
+	PROCESS_END();
+}
@@ -0,0 +1,64 @@
+/*
+ * Skeleton shared by the nodes of the house (Node1, Node2 and Node4).
+ *
+ * A node file only implements its own commands. node_init() starts the
+ * serial log and the trace, opens the reliable connection with the CU,
+ * announces the capabilities of the node (HOME_CAPS, see home.h) and, with
+ * OTA_CONF_ENABLED, starts receiving the updates (see ota.h). Every
+ * command received, in unicast or in acknowledged broadcast, is logged and
+ * passed to the handler of the node in the order it comes in the frame,
+ * except for the ones all the nodes answer in the same way: 8 (energy report)
+ * and 9 (trace dump).
+ *
+ * Replies and reports go to the CU through node_send(), which charges an
+ * energy slot until the CU acknowledges them. The nodes with group commands
+ * (1 and 3) also call node_open_group(): the alarm of command 1
+ * (node_alarm_toggle()) and the guest entrance schedule of command 3
+ * (node_guest()) are the same on Node1 and Node2.
+ *
+ * node.c is linked in every node, but the functions a node never calls, and
+ * the modules only they use (groupcast, schedules, LED patterns), are left
+ * out of its image (see the Makefile).
+ */
+
+#ifndef NODE_H_
+#define NODE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "message.h"
+
+#ifdef NODE_CONF_MAX_RETRANSMISSIONS
+#define NODE_MAX_RETRANSMISSIONS NODE_CONF_MAX_RETRANSMISSIONS
+#else
+#define NODE_MAX_RETRANSMISSIONS 5
+#endif
+
+/* Initialise the node, which must have Rime address addr.0 (HOME_ADDR);
+ command() is called for every command of the node, with the address of the
+ CU that has sent it. Before an update replaces the node file (see ota.h),
+ the connections, schedules and LED patterns of the skeleton are stopped and
+ exit() (NULL if not needed) stops the ctimers, the connections and the
+ sampler requests of the node file. */
+void node_init(uint8_t addr, uint16_t caps,
+		void (*command)(const struct msg_record *record, const linkaddr_t *from),
+		void (*exit)(void));
+
+/* Receive the group commands (acknowledged broadcast, see groupcast.h) and
+ start the LED patterns and the guest entrance schedules. */
+void node_open_group(void);
+
+/* Command 3: charge its energy slot and load the schedule sent by the CU.
+ Returns 0 if the blinking is scheduled, 1 if the node must start it. */
+int node_guest(const struct msg_record *record);
+
+/* Send the frame in the packetbuf to the CU. The energy slot (ENERGY_SLOTS for
+ none) is charged until the frame is acknowledged. Returns 0, and ends the
+ slot, if another frame is still in flight. */
+int node_send(uint8_t slot);
+
+/* Command 1: switch the alarm on or off, returns 1 if it is now on. */
+int node_alarm_toggle(void);
+int node_alarm_on(void);
+
+#endif /* NODE_H_ */
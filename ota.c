@@ -0,0 +1,407 @@
+/*
+ * Implementation of the differential updates (see ota.h).
+ */
+
+#include "ota.h"
+#include "cfs/cfs.h"
+#include "cfs/cfs-coffee.h"
+#include "lib/crc16.h"
+#include "loader/elfloader.h"
+#include "sys/autostart.h"
+#include "net/rime/rudolph1.h"
+#include "serlog.h"
+
+//time between two chunks of the delta sent by the CU
+#ifdef OTA_CONF_SEND_INTERVAL
+#define OTA_SEND_INTERVAL OTA_CONF_SEND_INTERVAL
+#else
+#define OTA_SEND_INTERVAL (CLOCK_SECOND/4)
+#endif
+
+#define DELTA_FILE "ota.d"
+#define ACTIVE_FILE "ota.a"	//'0' or '1', the slot installed
+#define NO_SLOT -1
+
+/*Coffee takes the trailing 0x00 bytes of a file for free space after a
+ reboot, and images and deltas may end with zeros: their length and a marker
+ follow them on flash*/
+#define FOOTER_LEN 3
+#define IMAGE_END 'I'
+#define DELTA_END 'D'
+
+static const char *const slot_names[2] = {"ota.0", "ota.1"};
+
+static struct rudolph1_conn rudolph;
+static uint8_t opened = 0;
+static void (*delta_received)(void);
+static void (*image_exit)(void);
+//bytes of the delta stored on flash, the ones the node can serve
+static uint16_t stored = 0;
+
+//slot of the module running, NO_SLOT for the firmware in ROM
+static int8_t loaded = NO_SLOT;
+static struct process * const *running = NULL;
+
+struct delta_header {
+	uint8_t target;
+	uint16_t old_len, old_crc;
+	uint16_t new_len, new_crc;
+};
+
+PROCESS(ota_process, "OTA install");
+
+static int read_all(int fd, uint8_t *to, int len) {
+	return cfs_read(fd, to, len)==len;
+}
+
+static uint16_t get_uint16(const uint8_t *p) {
+	return p[0] | (uint16_t)p[1] << 8;
+}
+
+//write after the len bytes of a file their footer, returns 1 on success
+static int write_footer(int fd, uint16_t len, uint8_t marker) {
+	uint8_t buf[FOOTER_LEN];
+
+	buf[0] = len & 0xff;
+	buf[1] = len >> 8;
+	buf[2] = marker;
+	return cfs_seek(fd, len, CFS_SEEK_SET)==len && cfs_write(fd, buf, FOOTER_LEN)==FOOTER_LEN;
+}
+
+//length of the contents of a file before its footer, -1 if it has none
+static int footer_len(int fd, uint8_t marker) {
+	uint8_t buf[FOOTER_LEN];
+	cfs_offset_t end = cfs_seek(fd, 0, CFS_SEEK_END);
+
+	if (end<FOOTER_LEN || cfs_seek(fd, end-FOOTER_LEN, CFS_SEEK_SET)!=end-FOOTER_LEN
+			|| !read_all(fd, buf, FOOTER_LEN) || buf[2]!=marker
+			|| get_uint16(buf)!=end-FOOTER_LEN)
+		return -1;
+	return end-FOOTER_LEN;
+}
+
+//length of the complete delta on flash, 0 if there is none
+static uint16_t delta_len(void) {
+	int fd, len;
+
+	fd = cfs_open(DELTA_FILE, CFS_READ);
+	if (fd<0)
+		return 0;
+	len = footer_len(fd, DELTA_END);
+	cfs_close(fd);
+	return (len<0)? 0:len;
+}
+
+static void write_chunk(struct rudolph1_conn *c, int offset, int flag, uint8_t *data, int len) {
+	int fd;
+
+	if (flag & RUDOLPH1_FLAG_NEWFILE) {
+		cfs_remove(DELTA_FILE);
+		cfs_coffee_reserve(DELTA_FILE, OTA_MAX_SIZE+FOOTER_LEN);
+		stored = 0;
+	}
+	if (offset+len>OTA_MAX_SIZE)
+		return;
+
+	fd = cfs_open(DELTA_FILE, CFS_WRITE | CFS_APPEND);
+	if (fd<0)
+		return;
+	cfs_seek(fd, offset, CFS_SEEK_SET);
+	if (cfs_write(fd, data, len)==len)
+		stored = offset+len;
+	//a complete delta can still be served and installed after a reboot
+	if ((flag & RUDOLPH1_FLAG_LASTCHUNK) && !write_footer(fd, stored, DELTA_END))
+		stored = 0;
+	cfs_close(fd);
+
+	if ((flag & RUDOLPH1_FLAG_LASTCHUNK) && stored>0) {
+		serlog(LOG_OTA_RECEIVED, stored);
+		if (delta_received!=NULL)
+			delta_received();
+	}
+}
+
+static int read_chunk(struct rudolph1_conn *c, int offset, uint8_t *to, int maxsize) {
+	int fd, len;
+
+	if (offset>=stored)
+		return 0;
+	fd = cfs_open(DELTA_FILE, CFS_READ);
+	if (fd<0)
+		return 0;
+	cfs_seek(fd, offset, CFS_SEEK_SET);
+	len = cfs_read(fd, to, (stored-offset<maxsize)? stored-offset:maxsize);
+	cfs_close(fd);
+	return (len<0)? 0:len;
+}
+
+static const struct rudolph1_callbacks rudolph_calls = {write_chunk, read_chunk};
+
+void ota_open(uint16_t channel, void (*received)(void), void (*exit)(void)) {
+	//the modules call node_init() again once loaded
+	if (opened)
+		return;
+	opened = 1;
+	delta_received = received;
+	image_exit = exit;
+	stored = delta_len();
+	rudolph1_open(&rudolph, channel, &rudolph_calls);
+}
+
+int ota_store(uint16_t offset, const uint8_t *data, uint8_t len) {
+	int fd;
+
+	if (offset==0) {
+		cfs_remove(DELTA_FILE);
+		cfs_coffee_reserve(DELTA_FILE, OTA_MAX_SIZE+FOOTER_LEN);
+		stored = 0;
+	}
+	if (offset>stored || offset+len>OTA_MAX_SIZE)
+		return -1;
+
+	fd = cfs_open(DELTA_FILE, CFS_WRITE | CFS_APPEND);
+	if (fd<0)
+		return -1;
+	cfs_seek(fd, offset, CFS_SEEK_SET);
+	if (cfs_write(fd, data, len)!=len) {
+		cfs_close(fd);
+		return -1;
+	}
+	cfs_close(fd);
+	stored = offset+len;
+	return stored;
+}
+
+int ota_send(void) {
+	int fd, ok;
+
+	if (stored<OTA_HEADER_LEN)
+		return -1;
+	fd = cfs_open(DELTA_FILE, CFS_WRITE | CFS_APPEND);
+	if (fd<0)
+		return -1;
+	ok = write_footer(fd, stored, DELTA_END);
+	cfs_close(fd);
+	if (!ok)
+		return -1;
+	rudolph1_send(&rudolph, OTA_SEND_INTERVAL);
+	return stored;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Installation on the nodes */
+
+static int read_header(int fd, struct delta_header *h) {
+	uint8_t buf[OTA_HEADER_LEN];
+
+	if (!read_all(fd, buf, OTA_HEADER_LEN) || buf[0]!='O' || buf[1]!='D')
+		return 0;
+	h->target = buf[2];
+	h->old_len = get_uint16(&buf[4]);
+	h->old_crc = get_uint16(&buf[6]);
+	h->new_len = get_uint16(&buf[8]);
+	h->new_crc = get_uint16(&buf[10]);
+	return 1;
+}
+
+//slot installed, NO_SLOT if there is none
+static int8_t active_slot(void) {
+	int fd;
+	uint8_t c;
+	int8_t slot = NO_SLOT;
+
+	fd = cfs_open(ACTIVE_FILE, CFS_READ);
+	if (fd<0)
+		return NO_SLOT;
+	if (read_all(fd, &c, 1) && (c=='0' || c=='1'))
+		slot = c-'0';
+	cfs_close(fd);
+	return slot;
+}
+
+//returns 1 on success
+static int set_active_slot(int8_t slot) {
+	uint8_t c = '0'+slot;
+	int fd, ok;
+
+	cfs_remove(ACTIVE_FILE);
+	fd = cfs_open(ACTIVE_FILE, CFS_WRITE);
+	if (fd<0)
+		return 0;
+	ok = cfs_write(fd, &c, 1)==1;
+	cfs_close(fd);
+	return ok;
+}
+
+//CRC16 and length of an image, 0 and 0 for no slot or no complete image
+static uint16_t image_crc(int8_t slot, uint16_t *len) {
+	uint8_t buf[32];
+	uint16_t crc = 0;
+	int fd, n, left;
+
+	*len = 0;
+	if (slot==NO_SLOT || (fd = cfs_open(slot_names[slot], CFS_READ))<0)
+		return 0;
+	left = footer_len(fd, IMAGE_END);
+	cfs_seek(fd, 0, CFS_SEEK_SET);
+	for (; left>0; left-=n) {
+		n = (left<sizeof(buf))? left:sizeof(buf);
+		if (!read_all(fd, buf, n)) {
+			crc = 0;
+			*len = 0;
+			break;
+		}
+		crc = crc16_data(buf, n, crc);
+		*len += n;
+	}
+	cfs_close(fd);
+	return crc;
+}
+
+/*
+ * Replace the running image with the module of slot: its code and data are
+ * going to be overwritten, so the running image stops its timers and
+ * callbacks and its processes exit first. Falls back on the firmware in ROM
+ * if the module cannot be loaded.
+ */
+static void load(int8_t slot) {
+	int fd, result;
+
+	fd = cfs_open(slot_names[slot], CFS_READ);
+	if (fd<0)
+		return;
+	if (image_exit!=NULL)
+		image_exit();
+	autostart_exit((running!=NULL)? running:autostart_processes);
+	result = elfloader_load(fd);
+	cfs_close(fd);
+
+	if (result!=ELFLOADER_OK) {
+		serlog(LOG_OTA_LOAD_FAILED, result);
+		loaded = NO_SLOT;
+		running = NULL;
+		autostart_start(autostart_processes);
+		return;
+	}
+	loaded = slot;
+	running = elfloader_autostart_processes;
+	autostart_start(running);
+}
+
+/*
+ * 1 if the delta stored is addressed to the node, is not installed yet and
+ * applies to the image in slot.
+ */
+static int delta_applies(struct delta_header *h, int8_t slot) {
+	uint16_t crc, len;
+	int fd, ok;
+
+	if (stored<OTA_HEADER_LEN || (fd = cfs_open(DELTA_FILE, CFS_READ))<0)
+		return 0;
+	ok = read_header(fd, h);
+	cfs_close(fd);
+	if (!ok || (h->target!=0 && h->target!=linkaddr_node_addr.u8[0]))
+		return 0;
+
+	crc = image_crc(slot, &len);
+	if (crc==h->new_crc && len==h->new_len)
+		return 0;
+	//a delta from an empty image carries the whole module
+	if (h->old_len>0 && (crc!=h->old_crc || len!=h->old_len)) {
+		serlog(LOG_OTA_REFUSED, "base image");
+		return 0;
+	}
+	return 1;
+}
+
+void ota_install(void) {
+	process_start(&ota_process, NULL);
+	process_poll(&ota_process);
+}
+
+PROCESS_THREAD(ota_process, ev, data) {
+	static struct delta_header h;
+	static int delta, old, new;
+	static int8_t slot, base;
+	static uint16_t len, at, written;
+	uint8_t buf[32];
+	uint8_t op;
+	int from, n;
+
+	PROCESS_BEGIN();
+
+	elfloader_init();
+
+	while(1) {
+		PROCESS_WAIT_EVENT_UNTIL(ev==PROCESS_EVENT_POLL);
+
+		slot = active_slot();
+		if (delta_applies(&h, slot)) {
+			//rebuild the new image in the other slot
+			base = slot;
+			slot = (base==0)? 1:0;
+			cfs_remove(slot_names[slot]);
+			cfs_coffee_reserve(slot_names[slot], h.new_len+FOOTER_LEN);
+			new = cfs_open(slot_names[slot], CFS_WRITE);
+			old = (h.old_len>0)? cfs_open(slot_names[base], CFS_READ):-1;
+			delta = cfs_open(DELTA_FILE, CFS_READ);
+			cfs_seek(delta, OTA_HEADER_LEN, CFS_SEEK_SET);
+			written = 0;
+			for (at=OTA_HEADER_LEN; at<stored && new>=0 && delta>=0; ) {
+				if (!read_all(delta, &op, 1))
+					break;
+				//the bytes come from the delta itself or from the old image
+				if (op<0x80) {
+					from = delta;
+					n = op+1;
+					at += 1+n;
+				} else {
+					if (old<0 || !read_all(delta, buf, 2))
+						break;
+					from = old;
+					cfs_seek(old, get_uint16(buf), CFS_SEEK_SET);
+					n = (op & 0x7f)+4;
+					at += 3;
+				}
+				for (; n>0; n-=len) {
+					len = (n<sizeof(buf))? n:sizeof(buf);
+					if (!read_all(from, buf, len) || cfs_write(new, buf, len)!=len)
+						break;
+					written += len;
+				}
+				if (n>0)
+					break;
+				//Coffee is slow to write: let the other processes run
+				PROCESS_PAUSE();
+			}
+			if (new>=0) {
+				//the footer gives the length, checked with the CRC below
+				write_footer(new, written, IMAGE_END);
+				cfs_close(new);
+			}
+			if (old>=0)
+				cfs_close(old);
+			if (delta>=0)
+				cfs_close(delta);
+
+			//switch only to a complete and intact image, kept at reboot
+			if (image_crc(slot, &len)!=h.new_crc || len!=h.new_len) {
+				serlog(LOG_OTA_REFUSED, "CRC");
+				cfs_remove(slot_names[slot]);
+				slot = base;
+			} else if (!set_active_slot(slot)) {
+				serlog(LOG_OTA_NOT_SAVED);
+				cfs_remove(slot_names[slot]);
+				slot = base;
+				if (base!=NO_SLOT)
+					set_active_slot(base);
+			} else
+				serlog(LOG_OTA_INSTALLED, h.new_len, h.new_crc);
+		}
+
+		if (slot!=NO_SLOT && slot!=loaded)
+			load(slot);
+	}
+
+	PROCESS_END();
+}
@@ -0,0 +1,87 @@
+/*
+ * Differential over-the-air updates of the nodes.
+ *
+ * The sky motes have no bootloader, so what is updated is not the whole
+ * firmware in ROM but the node file (Node1.c, Node2.c or Node4.c) built as a
+ * loadable module ("make Node1.ce TARGET=sky OTA=1"), which the elfloader
+ * links at run time against the symbols of the firmware. The firmware must
+ * therefore be built with its own symbol table ("make Node1.core TARGET=sky
+ * OTA=1", see the Makefile), and a module may only call the functions that
+ * its firmware links.
+ *
+ * Only the difference between the installed module and the new one goes over
+ * the air (mkdelta.py builds it; the first update of a node is a difference
+ * from an empty image). The CU receives the delta on the serial port (see
+ * CentralUnit.c) and disseminates it to the whole network at once with
+ * rudolph1: every node stores it on flash and serves it to the nodes that
+ * miss a part of it, so it also reaches the nodes out of range of the CU.
+ *
+ * The node the delta is addressed to applies it to its installed module into
+ * the other of the two slots on flash, checks the length and the CRC16 of the
+ * result, and only then switches: the processes of the running image (the
+ * ones in ROM the first time) exit and the new module is loaded and started.
+ * A module that cannot be loaded leaves the node running the firmware in ROM.
+ * At boot the installed module replaces the firmware in ROM again.
+ *
+ * The code and the data of a module are overwritten by the next one, so
+ * before its processes exit the running image gets an exit() call, which must
+ * stop its ctimers and pending requests and unregister its callbacks (for
+ * the nodes, see node_init() in node.h). The etimers of its processes go
+ * away with them.
+ *
+ * Updates are optional and disabled by default (OTA=1 on the make command
+ * line): they link the elfloader, Coffee and rudolph1 in every node and
+ * reserve ROM for the module (see project-conf.h), so check the images
+ * against their budgets ("make budget").
+ *
+ * Format of a delta (integers little endian):
+ * 		'O' 'D' target(1, node address or 0 for all) version(1)
+ * 		old_len(2) old_crc(2) new_len(2) new_crc(2)
+ * followed by the operations that rebuild the new image:
+ * 		0x00-0x7f	n+1 literal bytes follow
+ * 		0x80-0xff	copy (n & 0x7f)+4 bytes of the old image from the
+ * 					offset(2) that follows
+ *
+ * On flash, a delta and the images in the slots are followed by their length(2)
+ * and a marker byte, so that a reboot, after which Coffee cuts the trailing
+ * 0x00 bytes of a file, does not shorten them.
+ */
+
+#ifndef OTA_H_
+#define OTA_H_
+
+#include "contiki.h"
+
+#ifdef OTA_CONF_ENABLED
+#define OTA_ENABLED OTA_CONF_ENABLED
+#else
+#define OTA_ENABLED 0
+#endif
+
+//largest delta and image (bytes), the room reserved for them on flash
+#ifdef OTA_CONF_MAX_SIZE
+#define OTA_MAX_SIZE OTA_CONF_MAX_SIZE
+#else
+#define OTA_MAX_SIZE 8192
+#endif
+
+#define OTA_HEADER_LEN 12
+
+/* Open the dissemination of the updates on channels channel and channel+1.
+ received() is called when a whole delta has been stored, exit() before the
+ running image is replaced: both NULL on the CU, which only sends and relays
+ the updates. */
+void ota_open(uint16_t channel, void (*received)(void), void (*exit)(void));
+
+/* Nodes: install the delta received if it is addressed to the node, and load
+ the installed module if it is not running yet (at boot). */
+void ota_install(void);
+
+/* CU: store len bytes of the delta to send at offset (0 starts a new delta).
+ Returns the length of the delta stored so far, -1 on error. */
+int ota_store(uint16_t offset, const uint8_t *data, uint8_t len);
+
+/* CU: disseminate the stored delta. Returns its length, -1 if there is none. */
+int ota_send(void);
+
+#endif /* OTA_H_ */
@@ -0,0 +1,199 @@
+/*
+ * Over-the-air update of Node1, run by the ScriptRunner of ota.csc:
+ * 		java -jar cooja.jar -nogui=ota.csc -contiki=<contiki dir>
+ *
+ * The firmware of the motes is built with OTA=1, and the commands of the mote
+ * type of Node1 also build two versions of its module and their deltas (see
+ * ota.h and mkdelta.py): the first update installs the module on a node that
+ * only has its firmware in ROM (a difference from an empty image), the second
+ * one replaces it with a module built with a different TEMP_WINDOW.
+ *
+ * For every update the script writes the delta on the serial port of the CU,
+ * starts the dissemination and measures, until Node1 has installed the update
+ * and every other node has received it, the time and the frames and bytes
+ * transmitted by all the radios (the strobes of the RDC included). Node1 must
+ * then still answer command 4 from the new module. The results are written to
+ * ota.csv; the test fails if an update is not installed within DEADLINE.
+ */
+
+TIMEOUT(3600000, finish());
+
+var CU = 3;
+var NODE1 = 1;
+var NODES = [1, 2, 4];
+
+var WARMUP = 15000;		//ms
+var DEADLINE = 900000;	//ms allowed for the dissemination and installation
+var ANSWER = 10000;		//ms allowed for an answer of the CU
+//bytes of a delta per line: the line buffer of the CU holds 80 characters
+var CHUNK = 28;
+
+var UPDATES = [{name: "install", file: "Node1-1.delta"}, {name: "delta", file: "Node1-2.delta"}];
+var CSV = "ota.csv";
+
+var csv = "update,delta_bytes,frames_on_air,bytes_on_air,time_ms,result\n";
+var failures = [];
+var serial_id = 0;
+var counting = false;
+var frames = 0;
+var bytes = 0;
+var observers = [];
+var wait_id = 0;
+
+function now() {
+	return time/1000;
+}
+
+//count the frames transmitted by every radio while counting is set
+function watch_radios() {
+	var motes = sim.getMotes();
+	var i;
+
+	for (i=0; i<motes.length; i++) {
+		(function(radio) {
+			var o = new java.util.Observer({update: function(obs, arg) {
+				if (counting && String(radio.getLastEvent())=="PACKET_TRANSMITTED") {
+					frames++;
+					bytes += radio.getLastPacketTransmitted().getPacketData().length;
+				}
+			}});
+			radio.addObserver(o);
+			observers.push({radio: radio, observer: o});
+		})(motes[i].getInterfaces().getRadio());
+	}
+}
+
+/*
+ * Wait, at most ms, for a log message for which done(node, text) is true.
+ * Returns the message, or null on a timeout.
+ */
+function wait_until(done, ms) {
+	var tag = "ota wait " + wait_id++;
+
+	log.generateMessage(ms, tag);
+	while (true) {
+		YIELD();
+		if (msg.equals(tag))
+			return null;
+		if (done(id, String(msg)))
+			return String(msg);
+	}
+}
+
+function wait_for(node, pattern, ms) {
+	return wait_until(function(n, text) { return n==node && pattern.test(text); }, ms);
+}
+
+function sleep(ms) {
+	wait_until(function() { return false; }, ms);
+}
+
+//write a line on the serial port of the CU, returns the answer or null
+function cu_command(line) {
+	var answer;
+
+	serial_id++;
+	write(sim.getMoteWithID(CU), serial_id + " " + line);
+	answer = wait_for(CU, new RegExp("^@" + serial_id + " "), ANSWER);
+	if (answer==null || !/ ok /.test(answer))
+		return null;
+	return answer;
+}
+
+function hex(b) {
+	var s = (b & 0xff).toString(16);
+	return (s.length<2)? "0"+s:s;
+}
+
+//store the delta in the CU, returns its length or -1
+function upload(file) {
+	var dir = sim.getMoteWithID(NODE1).getType().getContikiFirmwareFile().getParentFile();
+	var data = java.nio.file.Files.readAllBytes(new java.io.File(dir, file).toPath());
+	var off, i, line;
+
+	for (off=0; off<data.length; off+=CHUNK) {
+		line = "ota " + off + " ";
+		for (i=off; i<data.length && i<off+CHUNK; i++)
+			line += hex(data[i]);
+		if (cu_command(line)==null)
+			return -1;
+	}
+	return data.length;
+}
+
+function update(u) {
+	var len = upload(u.file);
+	var received = {};
+	var missing = NODES.length;
+	var start, end, result = "PASS";
+	var installed = null;
+
+	if (len<0) {
+		failures.push(u.name + ": the CU refused the delta");
+		csv += u.name + ",,,,,FAIL\n";
+		return false;
+	}
+
+	frames = 0;
+	bytes = 0;
+	counting = true;
+	start = now();
+	if (cu_command("ota send")==null) {
+		counting = false;
+		failures.push(u.name + ": the CU did not send the delta");
+		csv += u.name + "," + len + ",,,,FAIL\n";
+		return false;
+	}
+
+	//every node receives the delta, Node1 also installs it
+	wait_until(function(node, text) {
+		if (/^Update of \d+ bytes received/.test(text) && received[node]===undefined) {
+			received[node] = now();
+			missing--;
+		} else if (node==NODE1 && /^Update installed/.test(text))
+			installed = now();
+		else if (node==NODE1 && /^Update (refused|not loaded)/.test(text))
+			failures.push(u.name + ": " + text);
+		return missing==0 && installed!=null;
+	}, DEADLINE);
+	counting = false;
+	end = now();
+
+	if (installed==null || missing>0) {
+		failures.push(u.name + ": not installed within " + DEADLINE + " ms");
+		result = "FAIL";
+	}
+	csv += u.name + "," + len + "," + frames + "," + bytes + "," + Math.round(end-start) + "," + result + "\n";
+	log.log(u.name + ": " + len + " bytes of delta, " + frames + " frames and " + bytes + " bytes on air\n");
+	return result=="PASS";
+}
+
+function finish() {
+	var i;
+
+	for (i=0; i<observers.length; i++)
+		observers[i].radio.deleteObserver(observers[i].observer);
+	log.writeFile(CSV, csv);
+	log.log(csv);
+	if (failures.length==0)
+		log.testOK();
+	else {
+		for (i=0; i<failures.length; i++)
+			log.log("FAIL " + failures[i] + "\n");
+		log.testFailed();
+	}
+}
+
+var u;
+
+watch_radios();
+sleep(WARMUP);
+for (u=0; u<UPDATES.length; u++) {
+	if (!update(UPDATES[u]))
+		break;
+	//the new module samples the temperature and answers command 4
+	sleep(12000);
+	if (cu_command("temp")==null || wait_for(CU, /^(Temperature average|No temperature)/, ANSWER)==null)
+		failures.push(UPDATES[u].name + ": Node1 does not answer command 4");
+}
+finish();
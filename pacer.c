@@ -0,0 +1,34 @@
+/*
+ * Implementation of the adaptive sampling period (see pacer.h).
+ */
+
+#include "pacer.h"
+
+void pacer_init(struct pacer *p, const struct pacer_limits *limits) {
+	p->limits = limits;
+	p->period = limits->min_period;
+	p->started = 0;
+}
+
+uint16_t pacer_update(struct pacer *p, int16_t mean, uint32_t variance) {
+	const struct pacer_limits *l = p->limits;
+	int32_t diff = (int32_t)mean-p->last_mean;
+	uint32_t rate;
+
+	if (diff<0)
+		diff = -diff;
+	//change of the mean per hour over the last period, none for the first sample
+	rate = p->started? (uint32_t)diff*3600/p->period:0;
+	p->last_mean = mean;
+	p->started = 1;
+
+	if (variance>l->active_var || rate>l->active_rate)
+		p->period = l->min_period;
+	else if (variance<=l->stable_var && rate<=l->stable_rate)
+		p->period = (p->period>l->max_period/2)? l->max_period:2*p->period;
+	return p->period;
+}
+
+uint16_t pacer_period(struct pacer *p) {
+	return p->period;
+}
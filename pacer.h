@@ -0,0 +1,51 @@
+/*
+ * Adaptive sampling period: a process that samples a slowly changing quantity
+ * asks, after every sample, how long to wait before the next one. The period
+ * doubles, up to max_period, while the readings are stable (the variance of
+ * the window and the rate of change of its mean are both at most the stable
+ * limits), and falls back to min_period as soon as one of them exceeds its
+ * active limit; in between it is kept as it is. The window of the statistics
+ * thus also delays the stretching after a change until the samples of the
+ * change have left it:
+ * 		period = pacer_update(&pacer, wstats_mean(&w), wstats_variance(&w));
+ * 		etimer_set(&et, period*CLOCK_SECOND);
+ *
+ * With weighted samples (wstats_add_weighted()) the mean, and so the rate, are
+ * weighted by time while the variance counts every sample once: a burst of
+ * samples after a change weighs more on the variance than on the mean, which
+ * keeps the period short until the burst has left the window.
+ *
+ * The limits are in the unit of the samples (variance in its square, rate in
+ * units per hour). Periods are in seconds and must stay below 512 on sky,
+ * where an etimer cannot last longer.
+ */
+
+#ifndef PACER_H_
+#define PACER_H_
+
+#include "contiki.h"
+
+struct pacer_limits {
+	uint16_t min_period, max_period;
+	uint32_t stable_var, active_var;
+	uint16_t stable_rate, active_rate;
+};
+
+struct pacer {
+	const struct pacer_limits *limits;
+	uint16_t period;
+	int16_t last_mean;
+	uint8_t started;
+};
+
+/* Start from the minimum period. */
+void pacer_init(struct pacer *p, const struct pacer_limits *limits);
+
+/* Account for a new sample, given the statistics of the window including it.
+ Returns the period until the next sample. */
+uint16_t pacer_update(struct pacer *p, int16_t mean, uint32_t variance);
+
+/* Period until the next sample. */
+uint16_t pacer_period(struct pacer *p);
+
+#endif /* PACER_H_ */
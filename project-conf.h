@@ -8,4 +8,74 @@
 #ifndef PROJECT_CONF_H_
 #define PROJECT_CONF_H_
 
+//Energest feeds the per-feature energy accounting of the nodes (energy.h)
+#define ENERGEST_CONF_ON 1
+
+/*network time for the scheduled actions (sched.h): timesynch needs the
+ timestamps of the start of frame delimiter taken by the cc2420*/
+#define TIMESYNCH_CONF_ENABLED 1
+#define CC2420_CONF_SFD_TIMESTAMPS 1
+
+//the nodes run as Linux processes linked by UDP on the loopback (native-radio.c)
+#if CONTIKI_TARGET_NATIVE
+#define NETSTACK_CONF_RADIO native_radio_driver
+#define NETSTACK_CONF_RDC nullrdc_driver
+#define NETSTACK_CONF_MAC csma_driver
+#endif
+
+/*radio duty cycling profile of the build, chosen with PROFILE= on the make
+ command line (see the Makefile). A ContikiMAC sender strobes for one cycle of
+ its own, so all the nodes must check the channel at the same rate: the role
+ of a node is therefore set at run time, the mains-powered CU keeps its radio
+ listening (CU_CONF_RADIO_ON) and acknowledges the strobes of the nodes at
+ once, while the battery nodes duty-cycle theirs.
+ 	LOWPOWER	ContikiMAC at PROFILE_CHECK_RATE Hz (a power of 2) with phase
+ 				optimization: a sender only strobes around the wake-up time it
+ 				has learned for the receiver
+ 	ALWAYSON	nullrdc on every node, the latency baseline
+ Without a profile every node, the CU too, runs the stack of the platform
+ (ContikiMAC at 8 Hz on sky).*/
+#if PROFILE_LOWPOWER && !CONTIKI_TARGET_NATIVE
+#ifndef PROFILE_CHECK_RATE
+#define PROFILE_CHECK_RATE 8
+#endif
+#define NETSTACK_CONF_RDC contikimac_driver
+#define NETSTACK_CONF_RDC_CHANNEL_CHECK_RATE PROFILE_CHECK_RATE
+#define CONTIKIMAC_CONF_WITH_PHASE_OPTIMIZATION 1
+#define CU_CONF_RADIO_ON 1
+#elif PROFILE_ALWAYSON
+#define NETSTACK_CONF_RDC nullrdc_driver
+#define CU_CONF_RADIO_ON 1
+#endif
+
+/*link-layer security, chosen with LLSEC=1 on the make command line: every
+ frame is encrypted and authenticated (AES-CCM*, 32-bit MIC) with a key shared
+ by the whole house, and the frame counters of the senders refuse the replayed
+ frames. The security adds 9 bytes to a frame (5 of auxiliary header and the
+ MIC), which still leaves room for MSG_MAX_LEN. On sky the AES runs in the
+ cc2420, on native in software. The beacons of timesynch go in clear (see
+ secure-framer.c).*/
+#if WITH_LLSEC
+#define LLSEC802154_CONF_ENABLED 1
+#define NETSTACK_CONF_LLSEC noncoresec_driver
+#define NONCORESEC_CONF_SEC_LVL 5	//ENC-MIC-32
+#ifndef NONCORESEC_CONF_KEY
+#define NONCORESEC_CONF_KEY { 0x5d, 0x1f, 0x73, 0x0a, 0xc4, 0x92, 0x3e, 0xb8, \
+		0x47, 0xe1, 0x06, 0x9c, 0x2b, 0xd5, 0x68, 0xf0 }
+#endif
+#if CONTIKI_TARGET_NATIVE
+#define NETSTACK_CONF_FRAMER secure_framer
+#else
+//the padding of ContikiMAC goes around the secured frame
+#define CONTIKIMAC_FRAMER_CONF_DECORATED_FRAMER secure_framer
+#define AES_128_CONF cc2420_aes_128_driver
+#endif
+#endif
+
+/*over-the-air updates (OTA=1, see ota.h): room for the code (ROM) of the
+ module of a node loaded by the elfloader*/
+#if OTA_CONF_ENABLED
+#define ELFLOADER_CONF_TEXTMEMORY_SIZE 0x1000
+#endif
+
 #endif /* PROJECT_CONF_H_ */
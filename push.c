@@ -0,0 +1,27 @@
+/*
+ * Implementation of send-on-delta reporting (see push.h).
+ */
+
+#include "push.h"
+
+void push_init(struct push *p, int16_t delta, unsigned long max_silence) {
+	p->delta = delta;
+	p->max_silence = max_silence;
+	p->started = 0;
+}
+
+int push_needed(struct push *p, int16_t value) {
+	int diff = value-p->last_value;
+
+	if (!p->started)
+		return 1;
+	if (diff >= p->delta || -diff >= p->delta)
+		return 1;
+	return clock_seconds()-p->last_time >= p->max_silence;
+}
+
+void push_sent(struct push *p, int16_t value) {
+	p->last_value = value;
+	p->last_time = clock_seconds();
+	p->started = 1;
+}
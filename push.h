@@ -0,0 +1,45 @@
+/*
+ * Send-on-delta reporting: a node samples in the background and transmits a
+ * value to the CU only when it has moved by at least delta since the last
+ * report, or when nothing has been reported for max_silence seconds (so the
+ * CU can tell a stable value from a dead node).
+ *
+ * Push mode is optional and disabled by default: when PUSH_CONF_ENABLED is
+ * set, Node1 pushes its temperature statistics and Node2 its light value, and
+ * the CU keeps their cached readings fresh for PUSH_MAX_SILENCE seconds.
+ */
+
+#ifndef PUSH_H_
+#define PUSH_H_
+
+#include "contiki.h"
+
+#ifdef PUSH_CONF_ENABLED
+#define PUSH_ENABLED PUSH_CONF_ENABLED
+#else
+#define PUSH_ENABLED 0
+#endif
+
+#ifdef PUSH_CONF_MAX_SILENCE
+#define PUSH_MAX_SILENCE PUSH_CONF_MAX_SILENCE
+#else
+#define PUSH_MAX_SILENCE 300
+#endif
+
+struct push {
+	int16_t delta;
+	unsigned long max_silence;
+	int16_t last_value;
+	unsigned long last_time;
+	uint8_t started;
+};
+
+void push_init(struct push *p, int16_t delta, unsigned long max_silence);
+
+/* Returns 1 if value has to be reported now. */
+int push_needed(struct push *p, int16_t value);
+
+/* The value has actually been transmitted. */
+void push_sent(struct push *p, int16_t value);
+
+#endif /* PUSH_H_ */
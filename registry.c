@@ -0,0 +1,121 @@
+/*
+ * Implementation of the node registry (see registry.h). As for the reading
+ * cache, the table is scanned linearly.
+ */
+
+#include "registry.h"
+#include "message.h"
+#include "transport.h"
+#include "lib/random.h"
+#include "serlog.h"
+
+//capabilities announced by the CU itself (it implements no command)
+#define CAPS_CU 0
+
+static struct announcement announcement;
+static struct registry_node nodes[REGISTRY_SIZE];
+
+static int expired(const struct registry_node *n) {
+	return n->caps==CAPS_CU || clock_seconds()-n->last_seen > REGISTRY_TTL;
+}
+
+void registry_update(const linkaddr_t *from, uint16_t caps) {
+	struct registry_node *n = registry_find(from);
+	int i;
+
+	if (n==NULL) {
+		//take an expired entry or, if there is none, the oldest one
+		n = &nodes[0];
+		for (i=0; i<REGISTRY_SIZE; i++) {
+			if (expired(&nodes[i])) {
+				n = &nodes[i];
+				break;
+			}
+			if (nodes[i].last_seen < n->last_seen)
+				n = &nodes[i];
+		}
+		linkaddr_copy(&n->addr, from);
+		serlog(LOG_NODE_REGISTERED, from->u8[0], from->u8[1], caps);
+	}
+	n->caps = caps;
+	n->last_seen = clock_seconds();
+}
+
+static void cu_heard(struct announcement *a, const linkaddr_t *from,
+		uint16_t id, uint16_t value) {
+	if (value!=CAPS_CU)
+		registry_update(from, value);
+}
+
+static void node_heard(struct announcement *a, const linkaddr_t *from,
+		uint16_t id, uint16_t value) {
+	//a CU has just booted: let it know about this node right away
+	if (value==CAPS_CU)
+		announcement_bump(&announcement);
+}
+
+void registry_init(void) {
+	announcement_register(&announcement, REGISTRY_ANNOUNCEMENT_ID, cu_heard);
+	announcement_set_value(&announcement, CAPS_CU);
+	announcement_bump(&announcement);
+}
+
+#if TRANSPORT_MESH
+static struct ctimer register_timer;
+static uint16_t registered_caps;
+
+//send the capabilities to the CU across the hops
+static void send_registration(void *ptr) {
+	linkaddr_t sink;
+
+	if (transport_is_transmitting()) {
+		ctimer_set(&register_timer, CLOCK_SECOND, send_registration, NULL);
+		return;
+	}
+	msg_init(MSG_REPORT);
+	msg_add_int16(READING_CAPS, registered_caps);
+	transport_sink(&sink);
+	transport_send(&sink, 5);
+	ctimer_set(&register_timer, REGISTRY_REFRESH*CLOCK_SECOND, send_registration, NULL);
+}
+#endif
+
+void registry_announce(uint16_t caps) {
+	announcement_register(&announcement, REGISTRY_ANNOUNCEMENT_ID, node_heard);
+	announcement_set_value(&announcement, caps);
+	announcement_bump(&announcement);
+#if TRANSPORT_MESH
+	//spread the first registrations of the nodes booting together
+	registered_caps = caps;
+	ctimer_set(&register_timer, CLOCK_SECOND+random_rand()%(2*CLOCK_SECOND),
+			send_registration, NULL);
+#endif
+}
+
+struct registry_node *registry_find(const linkaddr_t *addr) {
+	int i;
+
+	for (i=0; i<REGISTRY_SIZE; i++) {
+		if (!expired(&nodes[i]) && linkaddr_cmp(&nodes[i].addr, addr))
+			return &nodes[i];
+	}
+	return NULL;
+}
+
+static struct registry_node *scan(int from, uint16_t caps) {
+	int i;
+
+	for (i=from; i<REGISTRY_SIZE; i++) {
+		if (!expired(&nodes[i]) && (nodes[i].caps & caps)==caps)
+			return &nodes[i];
+	}
+	return NULL;
+}
+
+struct registry_node *registry_first(uint16_t caps) {
+	return scan(0, caps);
+}
+
+struct registry_node *registry_next(struct registry_node *n, uint16_t caps) {
+	return scan(n-nodes+1, caps);
+}
@@ -0,0 +1,83 @@
+/*
+ * Registry of the nodes of the house, filled from Rime announcements.
+ *
+ * Every node announces the commands it implements as a bitmask of CAP_* flags
+ * (registry_announce()); the CU listens to the announcements (registry_init())
+ * and keeps a small table of the nodes it has heard, so commands are routed by
+ * capability instead of by hard-coded addresses and a new room only needs a
+ * node with the right capabilities, not a new CU firmware. When the CU boots
+ * it announces itself, and the nodes bump their announcement as soon as they
+ * hear it, so the table is rebuilt without waiting for the next periodic
+ * announcement.
+ *
+ * Announcements only reach the nodes in radio range. In multi-hop mode
+ * (TRANSPORT_CONF_MESH, see transport.h) every node also sends its
+ * capabilities to the CU as a READING_CAPS report every REGISTRY_REFRESH
+ * seconds.
+ *
+ * A node that has not been heard for REGISTRY_TTL seconds is forgotten.
+ */
+
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+#define REGISTRY_ANNOUNCEMENT_ID 133
+
+//capabilities: the commands a node implements
+#define CAP_ALARM 0x0001	//command 1 (broadcast)
+#define CAP_GATE 0x0002		//command 2
+#define CAP_GUEST 0x0004	//command 3 (broadcast)
+#define CAP_TEMP 0x0008		//commands 4 and 7
+#define CAP_LIGHT 0x0010	//command 5
+#define CAP_STEAM 0x0020	//command 6
+#define CAP_ENERGY 0x0040	//command 8
+#define CAP_TRACE 0x0080	//command 9
+
+//number of nodes remembered by the CU
+#ifdef REGISTRY_CONF_SIZE
+#define REGISTRY_SIZE REGISTRY_CONF_SIZE
+#else
+#define REGISTRY_SIZE 16
+#endif
+
+/*seconds after which a silent node is forgotten: announcements are repeated
+ at least every 10 minutes by Rime*/
+#ifdef REGISTRY_CONF_TTL
+#define REGISTRY_TTL REGISTRY_CONF_TTL
+#else
+#define REGISTRY_TTL 1800
+#endif
+
+//seconds between two registrations of a node in multi-hop mode (< 512 on sky)
+#ifdef REGISTRY_CONF_REFRESH
+#define REGISTRY_REFRESH REGISTRY_CONF_REFRESH
+#else
+#define REGISTRY_REFRESH 300
+#endif
+
+struct registry_node {
+	linkaddr_t addr;
+	uint16_t caps;
+	unsigned long last_seen; //clock_seconds()
+};
+
+/* CU: listen to the announcements of the nodes and announce the CU. */
+void registry_init(void);
+
+/* Node: announce the capabilities of this node. */
+void registry_announce(uint16_t caps);
+
+/* CU: a node has been heard (READING_CAPS report in multi-hop mode). */
+void registry_update(const linkaddr_t *from, uint16_t caps);
+
+struct registry_node *registry_find(const linkaddr_t *addr);
+
+/* Iterate over the known nodes having all the capabilities in caps:
+ 		for (n=registry_first(CAP_TEMP); n!=NULL; n=registry_next(n, CAP_TEMP)) */
+struct registry_node *registry_first(uint16_t caps);
+struct registry_node *registry_next(struct registry_node *n, uint16_t caps);
+
+#endif /* REGISTRY_H_ */
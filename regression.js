@@ -0,0 +1,375 @@
+/*
+ * End-to-end latency regression for the commands of the CU, run by the
+ * ScriptRunner of regression.csc at the maximum simulation speed:
+ * 		java -jar cooja.jar -nogui=regression.csc -contiki=<contiki dir>
+ *
+ * For ROUNDS rounds the script presses the button of the CU N times for every
+ * command N and measures the time from the last press to the response (CU
+ * output) or to the actuation on the target nodes (the nodes print the command
+ * they execute). It also checks the LED timings of command 3 (Node1 starts
+ * blinking 14 s after the command, Node2 blinks for 16 s) and of command 1
+ * (2 s period, LEDs restored when the alarm is deactivated).
+ *
+ * Every round ends with a burst of commands written on the serial port of the
+ * CU (see CentralUnit.c), whose responses must arrive within SERIAL_THRESHOLD.
+ *
+ * The latency percentiles and the delivery ratio (commands answered within
+ * DEADLINE) of every command are written to LATENCY_CSV; the test fails if a
+ * p90 exceeds its threshold, if a blink timing is off by more than TOLERANCE
+ * or if a command gets no response at all.
+ *
+ * The same script runs multihop.csc (Node2 reachable only through Node1): the
+ * CSV is named after the title of the simulation, so the multi-hop results can
+ * be compared with the single-hop baseline of the same build.
+ *
+ * When the PowerTracker plugin is started, the radio duty cycle of every mote
+ * over the rounds (radio on, TX and RX time in % of the simulated time) is
+ * written to RADIO_CSV. lowpower.csc and alwayson.csc run the same rounds with
+ * the radio profiles of project-conf.h, to compare latency and duty cycle with
+ * the default stack of regression.csc. The radio-on time per command (ms) is the
+ * radio-on time of the mote divided by the commands of the rounds.
+ *
+ * secure.csc runs the rounds with the link-layer security (LLSEC=1, see
+ * project-conf.h): the latency and radio CSVs, compared with those of
+ * regression.csc, give the time and the energy the encryption adds to every
+ * command.
+ */
+
+TIMEOUT(7200000, finish());
+
+var CU = 3;
+var NODE1 = 1;
+var NODE2 = 2;
+var NODE4 = 4;
+
+var ROUNDS = 10;
+var WARMUP = 15000;		//ms, Node1 has its first temperature sample after 10 s
+var PRESS_GAP = 300;	//ms between two presses of the same command
+var DEADLINE = 10000;	//ms allowed for a response after the last press
+var TICK = 50;			//ms, resolution of the LED checks
+var TOLERANCE = 250;	//ms, allowed error on the blink timings
+
+/*p90 latency (ms) allowed for each command. The latency includes the idle
+ time the CU waits after the last press before it decides the command: it
+ adapts to PRESS_GAP within the first round (see gesture.h), and the first
+ rounds are left out by the p90.*/
+var THRESHOLD = {1: 2000, 2: 2000, 3: 2000, 4: 2200, 5: 2200, 6: 2000, serial: 100};
+var LATENCY_CSV = String(sim.getTitle()).toLowerCase().replace(/[^a-z0-9]+/g, "-") + ".csv";
+var RADIO_CSV = LATENCY_CSV.replace(/\.csv$/, "-radio.csv");
+
+var latencies = {1: [], 2: [], 3: [], 4: [], 5: [], 6: [], serial: []};
+var attempts = {1: 0, 2: 0, 3: 0, 4: 0, 5: 0, 6: 0, serial: 0};
+var serial_id = 0;
+var failures = [];
+var tick_tag = null;
+var ticks = 0;
+var tracked_since = 0;	//ms, last reset of the PowerTracker
+
+function now() {
+	return time/1000;
+}
+
+function leds(node) {
+	return sim.getMoteWithID(node).getInterfaces().getLED();
+}
+
+/*
+ * Wait for the next log message or tick. Returns null on a tick, so that the
+ * LEDs are sampled every TICK ms even when the motes print nothing.
+ */
+function step() {
+	if (tick_tag==null) {
+		tick_tag = "regression tick " + ticks++;
+		//GENERATE_MSG() only takes a constant delay
+		log.generateMessage(TICK, tick_tag);
+	}
+	YIELD();
+	if (msg.equals(tick_tag)) {
+		tick_tag = null;
+		return null;
+	}
+	return {node: id, text: String(msg), at: now()};
+}
+
+function sleep(ms) {
+	var until = now()+ms;
+
+	while (now()<until)
+		step();
+}
+
+//press the button of the CU n times, returns the time of the last press
+function press(n) {
+	var i, last = 0;
+
+	for (i=0; i<n; i++) {
+		sim.getMoteWithID(CU).getInterfaces().getButton().clickButton();
+		last = now();
+		if (i<n-1)
+			sleep(PRESS_GAP);
+	}
+	return last;
+}
+
+/*
+ * Give command n and wait until every expected {node, pattern} has been seen.
+ * Records the latency of the slowest one and returns the arrival time of each
+ * expectation (keyed by node), or null on a timeout. watch(), if given, is
+ * called at every step to follow the LEDs.
+ */
+function command(n, expected, watch) {
+	var start = press(n);
+	var seen = {};
+
+	attempts[n]++;
+	var missing = expected.length;
+	var latest = start;
+	var e, i;
+
+	while (missing>0 && now()-start<DEADLINE) {
+		e = step();
+		if (watch)
+			watch();
+		if (e==null)
+			continue;
+		for (i=0; i<expected.length; i++) {
+			if (seen[i]===undefined && e.node==expected[i].node && expected[i].pattern.test(e.text)) {
+				seen[i] = e.at;
+				missing--;
+				latest = Math.max(latest, e.at);
+			}
+		}
+	}
+
+	if (missing>0) {
+		failures.push("command " + n + ": no response within " + DEADLINE + " ms");
+		return null;
+	}
+	latencies[n].push(latest-start);
+	for (i=0; i<expected.length; i++)
+		seen[expected[i].node] = seen[i];
+	return seen;
+}
+
+function check(what, measured, expected) {
+	var line = what + ": " + Math.round(measured) + " ms (expected " + expected + " ms)";
+
+	log.log(line + "\n");
+	if (Math.abs(measured-expected)>TOLERANCE)
+		failures.push(line);
+}
+
+//time of the rising edges of a LED state sampled at every step
+function edges(get) {
+	var t = {last: get(), rising: [], falling: []};
+
+	t.update = function() {
+		var v = get();
+		if (v && !t.last)
+			t.rising.push(now());
+		else if (!v && t.last)
+			t.falling.push(now());
+		t.last = v;
+	};
+	return t;
+}
+
+//command 3: Node1 blinks after 14 s, Node2 blinks for 16 s, 2 s period
+function guest_entrance() {
+	var blue1 = edges(function() { return leds(NODE1).isYellowOn(); });
+	var blue2 = edges(function() { return leds(NODE2).isYellowOn(); });
+	var watch = function() { blue1.update(); blue2.update(); };
+	var rx = command(3, [{node: NODE1, pattern: /^Command: 3$/}, {node: NODE2, pattern: /^Command: 3$/}], watch);
+	var until;
+
+	if (rx==null)
+		return;
+	until = Math.max(rx[NODE1], rx[NODE2])+18000;
+	while (now()<until) {
+		step();
+		watch();
+	}
+
+	/*a blinking LED goes on half a period (1 s) after the blinking starts, and
+	 Node2 turns it off for the last time when the blinking stops*/
+	if (blue1.rising.length<1 || blue2.rising.length<2 || blue2.falling.length<1) {
+		failures.push("command 3: blue LEDs did not blink");
+		return;
+	}
+	check("Node1 blinking start", blue1.rising[0]-1000-rx[NODE1], 14000);
+	check("Node2 blinking duration", blue2.falling[blue2.falling.length-1]-rx[NODE2], 16000);
+	check("Node2 blinking period", blue2.rising[1]-blue2.rising[0], 2000);
+}
+
+//command 1 twice: the LEDs blink with a 2 s period and are then restored
+function alarm() {
+	var before1 = leds(NODE1).isRedOn() + "," + leds(NODE1).isGreenOn() + "," + leds(NODE1).isYellowOn();
+	var before2 = leds(NODE2).isRedOn() + "," + leds(NODE2).isGreenOn() + "," + leds(NODE2).isYellowOn();
+	var all1 = edges(function() { return leds(NODE1).isAnyOn(); });
+	var all2 = edges(function() { return leds(NODE2).isAnyOn(); });
+	var watch = function() { all1.update(); all2.update(); };
+	var expected = [{node: NODE1, pattern: /^Command: 1$/}, {node: NODE2, pattern: /^Command: 1$/}];
+	var until;
+
+	if (command(1, expected, watch)==null)
+		return;
+	until = now()+7000;
+	while (now()<until) {
+		step();
+		watch();
+	}
+	if (all1.rising.length<2 || all2.rising.length<2)
+		failures.push("command 1: LEDs did not blink");
+	else {
+		check("Node1 alarm period", all1.rising[1]-all1.rising[0], 2000);
+		check("Node2 alarm period", all2.rising[1]-all2.rising[0], 2000);
+	}
+
+	if (command(1, expected)==null)
+		return;
+	sleep(500);
+	if (before1!=leds(NODE1).isRedOn() + "," + leds(NODE1).isGreenOn() + "," + leds(NODE1).isYellowOn()
+			|| before2!=leds(NODE2).isRedOn() + "," + leds(NODE2).isGreenOn() + "," + leds(NODE2).isYellowOn())
+		failures.push("command 1: LEDs not restored after the alarm");
+}
+
+/*
+ * Write a burst of commands on the serial port of the CU, without waiting in
+ * between, and measure the time until each one is answered (@<id> ok).
+ */
+function serial_burst() {
+	var lines = ["ping", "gate", "gate", "temp", "light 0x", "5"];
+	var sent = {};
+	var missing = 0;
+	var start = now();
+	var e, m, i;
+
+	for (i=0; i<lines.length; i++) {
+		serial_id++;
+		write(sim.getMoteWithID(CU), serial_id + " " + lines[i]);
+		sent[serial_id] = {line: lines[i], at: now()};
+		attempts.serial++;
+		missing++;
+	}
+
+	while (missing>0 && now()-start<DEADLINE) {
+		e = step();
+		if (e==null || e.node!=CU || (m = /^@(\d+) (ok|err)/.exec(e.text))==null || sent[m[1]]===undefined)
+			continue;
+		//the malformed line must be refused, all the others accepted
+		if ((m[2]=="ok")!=(sent[m[1]].line!="light 0x"))
+			failures.push("serial \"" + sent[m[1]].line + "\": " + e.text);
+		latencies.serial.push(e.at-sent[m[1]].at);
+		delete sent[m[1]];
+		missing--;
+	}
+	if (missing>0)
+		failures.push("serial: " + missing + " commands not answered within " + DEADLINE + " ms");
+}
+
+function power_tracker() {
+	return sim.getCooja().getStartedPlugin("PowerTracker");
+}
+
+//radio duty cycle of every mote since the last reset of the PowerTracker
+function radio_report(tracker) {
+	var csv = "mote,on,tx,rx,on_per_command\n";
+	var motes = {};
+	var commands = 0;
+	var lines = String(tracker.radioStatistics()).split("\n");
+	var m, i, n;
+
+	//lines like "Sky 3 ON 123456 us 1.23 %"
+	for (i=0; i<lines.length; i++) {
+		m = /(\d+) (ON|TX|RX) \d+ us\s+([0-9.]+) %/.exec(lines[i]);
+		if (m==null)
+			continue;
+		if (motes[m[1]]===undefined)
+			motes[m[1]] = {};
+		motes[m[1]][m[2]] = m[3];
+	}
+	for (n in attempts)
+		commands += attempts[n];
+	for (n in motes)
+		csv += n + "," + motes[n].ON + "," + motes[n].TX + "," + motes[n].RX + ","
+				+ (commands>0? (motes[n].ON/100*(now()-tracked_since)/commands).toFixed(1):"") + "\n";
+	log.writeFile(RADIO_CSV, csv);
+	log.log(csv);
+}
+
+//nearest-rank percentile of a sorted array
+function percentile(sorted, p) {
+	return sorted[Math.max(0, Math.ceil(p/100*sorted.length)-1)];
+}
+
+function finish() {
+	var csv = "command,samples,delivery,min,p50,p90,p99,max,threshold,result\n";
+	var n, s, p90, result;
+
+	for (n in latencies) {
+		s = latencies[n].slice().sort(function(a, b) { return a-b; });
+		if (s.length==0) {
+			csv += n + ",0,0,,,,,," + THRESHOLD[n] + ",FAIL\n";
+			failures.push("command " + n + ": no samples");
+			continue;
+		}
+		p90 = percentile(s, 90);
+		result = (p90<=THRESHOLD[n])? "PASS":"FAIL";
+		if (result=="FAIL")
+			failures.push("command " + n + ": p90 " + Math.round(p90) + " ms over " + THRESHOLD[n] + " ms");
+		csv += n + "," + s.length + "," + (s.length/attempts[n]).toFixed(2) + "," + Math.round(s[0]) + "," + Math.round(percentile(s, 50)) + ","
+				+ Math.round(p90) + "," + Math.round(percentile(s, 99)) + "," + Math.round(s[s.length-1]) + ","
+				+ THRESHOLD[n] + "," + result + "\n";
+	}
+	log.writeFile(LATENCY_CSV, csv);
+	log.log(csv);
+	if (power_tracker()!=null)
+		radio_report(power_tracker());
+
+	if (failures.length==0)
+		log.testOK();
+	else {
+		for (n=0; n<failures.length; n++)
+			log.log("FAIL " + failures[n] + "\n");
+		log.testFailed();
+	}
+}
+
+var round;
+
+sleep(WARMUP);
+//the duty cycle only covers the rounds, not the boot of the nodes
+if (power_tracker()!=null) {
+	power_tracker().reset();
+	tracked_since = now();
+}
+for (round=1; round<=ROUNDS; round++) {
+	log.log("Round " + round + "\n");
+
+	//lock and unlock the gate
+	command(2, [{node: NODE2, pattern: /^Command: 2$/}]);
+	sleep(1000);
+	command(2, [{node: NODE2, pattern: /^Command: 2$/}]);
+	sleep(1000);
+
+	//temperature and light, either from the nodes or from the cache of the CU
+	command(4, [{node: CU, pattern: /^(Temperature average|No temperature)/}]);
+	sleep(1000);
+	command(5, [{node: CU, pattern: /^Outer light/}]);
+	sleep(1000);
+
+	//switch the steam room on and off
+	command(6, [{node: NODE4, pattern: /switching on/}]);
+	sleep(1000);
+	command(6, [{node: NODE4, pattern: /switching off/}]);
+	sleep(1000);
+
+	guest_entrance();
+	sleep(1000);
+	alarm();
+	sleep(1000);
+
+	serial_burst();
+	sleep(1000);
+}
+finish();
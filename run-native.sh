@@ -0,0 +1,42 @@
+#!/bin/sh
+#
+# Run the whole house on this host with the native builds (see native-radio.c
+# and native-sensors.h): Node1, Node2 and Node4 in the background, the CU in
+# the foreground, with its serial port (the commands of CentralUnit.c) on
+# stdin and stdout. Every node runs in its own directory under RUN_DIR, where
+# it keeps its files (the temperature log of Node1) and its output (node.log).
+#
+#	./run-native.sh					build and run
+#	SANITIZE=address ./run-native.sh	build with a sanitizer
+#	RUN="valgrind -q" ./run-native.sh	run the nodes under a tool
+#
+# The button of a node is pressed with kill -USR1 <pid>, the pids are listed
+# in RUN_DIR/pids (e.g. kill -USR1 $(awk '/^CentralUnit/ {print $2}' _native/pids)). RADIO_LOSS and the SIM_* variables are passed to the nodes.
+
+set -e
+#the nodes run from RUN_DIR, which may be anywhere: absolute paths to the images
+REPO=$(cd "$(dirname "$0")" && pwd)
+cd "$REPO"
+RUN_DIR=${RUN_DIR:-_native}
+
+make TARGET=native ${SANITIZE:+SANITIZE=$SANITIZE} CentralUnit Node1 Node2 Node4
+
+mkdir -p "$RUN_DIR"
+RUN_DIR=$(cd "$RUN_DIR" && pwd)
+: > "$RUN_DIR/pids"
+trap 'kill $(cut -d" " -f2 "$RUN_DIR/pids") 2>/dev/null' EXIT INT TERM
+
+start() {
+	mkdir -p "$RUN_DIR/$1"
+	(cd "$RUN_DIR/$1" && NODE_ADDR=$2 exec $RUN "$REPO/$1.native" > node.log 2>&1 < /dev/null) &
+	echo "$1 $!" >> "$RUN_DIR/pids"
+}
+
+start Node1 1.0
+start Node2 2.0
+start Node4 4.0
+
+#the CU stays in the foreground, on the terminal
+mkdir -p "$RUN_DIR/CentralUnit"
+cd "$RUN_DIR/CentralUnit"
+NODE_ADDR=3.0 sh -c 'echo "CentralUnit $$" >> ../pids; exec '"$RUN"' "$0"' "$REPO/CentralUnit.native"
@@ -0,0 +1,209 @@
+/*
+ * Adaptive temperature sampling of Node1, run by the ScriptRunner of
+ * sampling.csc:
+ * 		java -jar cooja.jar -nogui=sampling.csc -contiki=<contiki dir>
+ *
+ * The script drives the temperature of the SHT11 of Node1 (SkyTemperature
+ * interface) through three phases: an hour at a constant temperature, a ramp
+ * of RAMP_RATE C per minute and another hour at the final temperature. Node1
+ * logs every change of its sampling period (see pacer.h), from which the
+ * script counts the samples taken in every phase; the CPU time Node1 charges
+ * to the temperature monitoring (energy report, command 8) gives the cost of
+ * the wakeups. The results are written to sampling.csv.
+ *
+ * The test fails if a stable hour costs more than a tenth of the samples and
+ * of the CPU time of sampling every MIN_PERIOD, or if Node1 is not back to
+ * MIN_PERIOD within MAX_PERIOD+MIN_PERIOD of the start of the ramp.
+ */
+
+TIMEOUT(14400000, finish());
+
+var CU = 3;
+var NODE1 = 1;
+
+var MIN_PERIOD = 10;	//s, NODE1_CONF_MIN_PERIOD
+var MAX_PERIOD = 160;	//s, NODE1_CONF_MAX_PERIOD
+var SETTLE = 600000;	//ms before the first phase, to reach MAX_PERIOD
+var HOUR = 3600000;		//ms
+var RAMP = 1200000;		//ms
+var RAMP_STEP = 30000;	//ms between two changes of the temperature
+var RAMP_RATE = 1;		//C per minute
+var BASE_TEMP = 20;		//C
+var ANSWER = 10000;		//ms allowed for an answer of the CU
+
+var CSV = "sampling.csv";
+
+var csv = "phase,duration_s,samples,fixed_samples,cpu_ms,fixed_cpu_ms,result\n";
+var failures = [];
+var serial_id = 0;
+var wait_id = 0;
+var period = MIN_PERIOD;
+var period_since = 0;
+var samples = 0;		//samples since the start of the current phase
+var ramp_start = -1;
+var back_to_min = -1;
+
+function now() {
+	return time/1000;
+}
+
+//account for the samples taken at the current period up to now
+function count_samples() {
+	samples += (now()-period_since)/(period*1000);
+	period_since = now();
+}
+
+//track the changes of the period of Node1
+function track(node, text) {
+	var m;
+
+	if (node!=NODE1 || (m = /^Temperature sampling period: (\d+) s/.exec(text))==null)
+		return;
+	count_samples();
+	period = parseInt(m[1]);
+	if (ramp_start>=0 && back_to_min<0 && period==MIN_PERIOD)
+		back_to_min = now();
+}
+
+/*
+ * Wait, at most ms, for a log message for which done(node, text) is true,
+ * tracking the period of Node1 meanwhile. Returns the message, or null on a
+ * timeout.
+ */
+function wait_until(done, ms) {
+	var tag = "sampling wait " + wait_id++;
+
+	log.generateMessage(ms, tag);
+	while (true) {
+		YIELD();
+		if (msg.equals(tag))
+			return null;
+		track(id, String(msg));
+		if (done(id, String(msg)))
+			return String(msg);
+	}
+}
+
+function sleep(ms) {
+	wait_until(function() { return false; }, ms);
+}
+
+//write a line on the serial port of the CU, returns the answer or null
+function cu_command(line) {
+	var answer;
+
+	serial_id++;
+	write(sim.getMoteWithID(CU), serial_id + " " + line);
+	answer = wait_until(function(n, text) {
+		return n==CU && text.indexOf("@" + serial_id + " ")==0;
+	}, ANSWER);
+	if (answer==null || !/ ok /.test(answer))
+		return null;
+	return answer;
+}
+
+//CPU time (ms) Node1 has charged to the temperature monitoring, -1 if unknown
+function monitoring_cpu() {
+	var report = false;
+	var line;
+
+	//slot 6 only (ENERGY_SLOT_TEMP)
+	if (cu_command("energy 64")==null)
+		return -1;
+	line = wait_until(function(n, text) {
+		if (n==CU && /^Energy report of /.test(text))
+			report = /^Energy report of 1\.0/.test(text);
+		return n==CU && report && /^Temperature monitoring: CPU/.test(text);
+	}, ANSWER);
+	return (line==null)? -1:parseInt(/CPU (\d+) ms/.exec(line)[1]);
+}
+
+//SHT11 of a mote, as seen by the simulator
+function sky_temperature(mote) {
+	var i, interfaces = mote.getInterfaces().getInterfaces().toArray();
+
+	for (i=0; i<interfaces.length; i++)
+		if (interfaces[i].getClass().getSimpleName()=="SkyTemperature")
+			return interfaces[i];
+	return null;
+}
+
+/*
+ * Run a phase of ms milliseconds, calling step(t) every RAMP_STEP if given.
+ * Returns the samples and the CPU time (-1 if unknown) of the phase.
+ */
+function phase(name, ms, step) {
+	var cpu = monitoring_cpu();
+	var t;
+
+	samples = 0;
+	period_since = now();
+	for (t=0; t<ms; t+=RAMP_STEP) {
+		if (step)
+			step(t);
+		sleep(Math.min(RAMP_STEP, ms-t));
+	}
+	count_samples();
+	if (cpu>=0)
+		cpu = monitoring_cpu()-cpu;
+	log.log(name + ": " + Math.round(samples) + " samples, " + cpu + " ms of CPU\n");
+	return {name: name, ms: ms, samples: Math.round(samples), cpu: cpu};
+}
+
+/*
+ * Compare a stable phase with sampling every MIN_PERIOD, whose cost is the one
+ * of the samples of the ramp (taken at MIN_PERIOD).
+ */
+function check(p, ramp) {
+	var fixed = Math.round(p.ms/(MIN_PERIOD*1000));
+	var fixed_cpu = (p.cpu>=0 && ramp.cpu>=0 && ramp.samples>0)?
+			Math.round(ramp.cpu/ramp.samples*fixed):-1;
+	var result = "PASS";
+
+	if (p.samples*10>fixed || (fixed_cpu>=0 && p.cpu*10>fixed_cpu)) {
+		failures.push(p.name + ": " + p.samples + " samples and " + p.cpu
+				+ " ms of CPU, " + fixed + " and " + fixed_cpu + " at a fixed period");
+		result = "FAIL";
+	}
+	csv += p.name + "," + Math.round(p.ms/1000) + "," + p.samples + "," + fixed + ","
+			+ p.cpu + "," + fixed_cpu + "," + result + "\n";
+}
+
+function finish() {
+	var i;
+
+	log.writeFile(CSV, csv);
+	log.log(csv);
+	if (failures.length==0)
+		log.testOK();
+	else {
+		for (i=0; i<failures.length; i++)
+			log.log("FAIL " + failures[i] + "\n");
+		log.testFailed();
+	}
+}
+
+var sht11 = sky_temperature(sim.getMoteWithID(NODE1));
+var stable, ramp, again;
+
+if (sht11==null) {
+	failures.push("Node1 has no SkyTemperature interface");
+	finish();
+}
+sht11.setTemperature(BASE_TEMP);
+sleep(SETTLE);
+
+stable = phase("stable", HOUR, null);
+ramp_start = now();
+ramp = phase("ramp", RAMP, function(t) {
+	sht11.setTemperature(BASE_TEMP + RAMP_RATE*t/60000);
+});
+if (back_to_min<0 || back_to_min-ramp_start>(MAX_PERIOD+MIN_PERIOD)*1000)
+	failures.push("ramp: period not back to " + MIN_PERIOD + " s in time");
+again = phase("stable again", HOUR, null);
+
+check(stable, ramp);
+csv += "ramp," + Math.round(RAMP/1000) + "," + ramp.samples + "," + Math.round(RAMP/(MIN_PERIOD*1000))
+		+ "," + ramp.cpu + ",,\n";
+check(again, ramp);
+finish();
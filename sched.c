@@ -0,0 +1,164 @@
+/*
+ * Implementation of the actions scheduled at a network time (see sched.h).
+ */
+
+#include "sched.h"
+#include "serlog.h"
+
+//network (rtimer) ticks per clock tick
+#define NET_PER_CLOCK (RTIMER_SECOND/CLOCK_SECOND)
+
+static struct {
+	uint8_t action;		//0 if the slot is free
+	uint16_t net;		//deadline in network time
+	clock_time_t due;	//deadline on the local clock, to count the wraps
+} pending[SCHED_ACTIONS];
+
+static struct ctimer timer;
+static void (*run_action)(uint8_t action);
+
+int sched_add(uint8_t code, const struct sched_action *actions, int n) {
+	uint8_t buf[MSG_MAX_LEN];
+	uint8_t *p = &buf[SCHED_HEADER_LEN];
+	uint16_t origin = timesynch_time();
+	int i;
+
+	if (n>SCHED_RECORD_ACTIONS)
+		return 0;
+
+	buf[0] = origin & 0xff;
+	buf[1] = origin >> 8;
+	msg_put_uint32(&buf[2], 0);
+	for (i=0; i<n; i++, p+=SCHED_ENTRY_LEN) {
+		p[0] = actions[i].target.u8[0];
+		p[1] = actions[i].target.u8[1];
+		p[2] = actions[i].action;
+		p[3] = actions[i].offset & 0xff;
+		p[4] = actions[i].offset >> 8;
+	}
+	return msg_add(code, buf, p-buf);
+}
+
+void sched_restamp(uint8_t code, clock_time_t elapsed) {
+	struct msg_reader reader;
+	struct msg_record record;
+	uint8_t *value;
+	uint16_t origin, fine;
+	uint32_t coarse;
+
+	if (msg_open(&reader)!=MSG_COMMAND)
+		return;
+
+	while (msg_next(&reader, &record)) {
+		if (record.code!=code || record.len<SCHED_HEADER_LEN)
+			continue;
+		//the record is in the packetbuf, so it can be patched in place
+		value = (uint8_t*)record.value;
+		origin = value[0] | (uint16_t)value[1] << 8;
+		/*the clock counts the wraps of the network time, the network time gives
+		 the exact ticks*/
+		coarse = (uint32_t)elapsed*NET_PER_CLOCK;
+		fine = (uint16_t)timesynch_time()-origin;
+		msg_put_uint32(&value[2], coarse+(int16_t)(fine-(uint16_t)coarse));
+	}
+}
+
+//clock ticks left before a deadline, negative once it has passed
+static int16_t left(clock_time_t due) {
+	return (int16_t)(due-clock_time());
+}
+
+//index of the earliest pending action, -1 if there is none
+static int earliest(void) {
+	int i, next = -1;
+
+	for (i=0; i<SCHED_ACTIONS; i++) {
+		if (pending[i].action!=0 && (next<0 || left(pending[i].due)<left(pending[next].due)))
+			next = i;
+	}
+	return next;
+}
+
+static void expire(void *ptr);
+
+static void arm(void) {
+	int next = earliest();
+	int16_t wait;
+
+	if (next<0) {
+		ctimer_stop(&timer);
+		return;
+	}
+	wait = left(pending[next].due)-SCHED_GUARD;
+	ctimer_set(&timer, (wait>0)? wait:0, expire, NULL);
+}
+
+static void expire(void *ptr) {
+	int next;
+	uint16_t wait;
+	uint8_t action;
+	rtimer_clock_t until;
+
+	while ((next = earliest())>=0 && left(pending[next].due)<=SCHED_GUARD) {
+		wait = pending[next].net-(uint16_t)timesynch_time();
+		if ((int16_t)wait>(SCHED_GUARD+1)*NET_PER_CLOCK) {
+			//the local clock has drifted from the network time: wait again
+			pending[next].due = clock_time()+wait/NET_PER_CLOCK;
+			continue;
+		}
+		//align on the network time for the last ticks
+		if ((int16_t)wait>0) {
+			until = RTIMER_NOW()+wait;
+			while (RTIMER_CLOCK_LT(RTIMER_NOW(), until));
+		}
+		action = pending[next].action;
+		pending[next].action = 0;
+		run_action(action);
+	}
+	arm();
+}
+
+void sched_init(void (*run)(uint8_t action)) {
+	run_action = run;
+	sched_cancel();
+}
+
+int sched_load(const struct msg_record *record) {
+	const uint8_t *p = record->value;
+	uint16_t origin;
+	uint32_t elapsed, offset;
+	int i, n = 0;
+
+	if (record->len<SCHED_HEADER_LEN)
+		return 0;
+
+	origin = p[0] | (uint16_t)p[1] << 8;
+	elapsed = msg_get_uint32(&p[2]);
+	//add the transit time of this copy of the frame, shorter than a wrap
+	elapsed += (uint16_t)((uint16_t)timesynch_time()-(uint16_t)(origin+elapsed));
+
+	for (p+=SCHED_HEADER_LEN; p+SCHED_ENTRY_LEN<=record->value+record->len; p+=SCHED_ENTRY_LEN) {
+		if (p[0]!=linkaddr_node_addr.u8[0] || p[1]!=linkaddr_node_addr.u8[1] || p[2]==0)
+			continue;
+		for (i=0; i<SCHED_ACTIONS && pending[i].action!=0; i++);
+		if (i==SCHED_ACTIONS) {
+			serlog(LOG_SCHEDULE_FULL, p[2]);
+			continue;
+		}
+		offset = ((uint32_t)p[3] | (uint32_t)p[4] << 8)*RTIMER_SECOND/1000;
+		pending[i].action = p[2];
+		pending[i].net = origin+offset;
+		pending[i].due = clock_time()+((offset>elapsed)? (offset-elapsed)/NET_PER_CLOCK:0);
+		n++;
+	}
+	arm();
+	return n;
+}
+
+void sched_cancel(void) {
+	int i;
+
+	for (i=0; i<SCHED_ACTIONS; i++)
+		pending[i].action = 0;
+	ctimer_stop(&timer);
+}
@@ -0,0 +1,79 @@
+/*
+ * Actions scheduled at a network time, to run multi-node sequences in step.
+ *
+ * The clocks of the nodes are aligned by Contiki's timesynch module (the CU is
+ * the time authority). Instead of sending a command and letting every node
+ * count its own delays from the moment it happens to receive it, the CU sends
+ * the whole choreography once: a schedule record lists, for every node, the
+ * actions to perform and their offsets (ms) from a common origin in network
+ * time. Reception jitter and retransmissions do not shift the sequence, and
+ * the drift of the local clocks is corrected by timesynch while waiting.
+ *
+ * The network time is a 16-bit rtimer value, so it wraps every 2 seconds on
+ * sky. The record therefore carries the origin together with its age at
+ * transmission (in network ticks, refreshed before every retransmission by
+ * sched_restamp()): a node only has to measure the transit time of the frame,
+ * which is always shorter than a wrap.
+ *
+ * A node waits for each deadline with a ctimer until SCHED_GUARD before it,
+ * then busy-waits on the network time for the last ticks, so all the nodes
+ * act within a few rtimer ticks of each other. The rtimer itself is left to
+ * the radio duty cycling.
+ *
+ * Record layout: origin (2 bytes), age (4 bytes), then for every action the
+ * target address (2 bytes), the action code (1 byte) and the offset in ms (2
+ * bytes, little-endian).
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "message.h"
+
+//actions a node can have pending at the same time
+#ifdef SCHED_CONF_ACTIONS
+#define SCHED_ACTIONS SCHED_CONF_ACTIONS
+#else
+#define SCHED_ACTIONS 4
+#endif
+
+//the coarse wait ends this long before the deadline (clock ticks)
+#ifdef SCHED_CONF_GUARD
+#define SCHED_GUARD SCHED_CONF_GUARD
+#else
+#define SCHED_GUARD 2
+#endif
+
+#define SCHED_HEADER_LEN 6
+#define SCHED_ENTRY_LEN 5
+//most actions a schedule record can carry in a frame
+#define SCHED_RECORD_ACTIONS ((MSG_MAX_LEN-2-SCHED_HEADER_LEN)/SCHED_ENTRY_LEN)
+
+struct sched_action {
+	linkaddr_t target;
+	uint8_t action;		//application-defined, never 0
+	uint16_t offset;	//ms after the origin
+};
+
+/* CU: append to the frame in the packetbuf a schedule record with origin now.
+ Returns 0 if it does not fit. */
+int sched_add(uint8_t code, const struct sched_action *actions, int n);
+
+/* CU: refresh the age of the schedule records with the given code before a
+ (re)transmission, elapsed clock ticks after sched_add(). */
+void sched_restamp(uint8_t code, clock_time_t elapsed);
+
+/* Node: run() is called, from the ctimer process, at the deadline of every
+ action. */
+void sched_init(void (*run)(uint8_t action));
+
+/* Node: schedule the actions of a record addressed to this node. Returns
+ their number. */
+int sched_load(const struct msg_record *record);
+
+/* Node: drop all the pending actions. */
+void sched_cancel(void);
+
+#endif /* SCHED_H_ */
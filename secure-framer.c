@@ -0,0 +1,63 @@
+/*
+ * Framer of the link-layer security (make LLSEC=1, see project-conf.h).
+ *
+ * Every frame is encrypted and authenticated by noncoresec, except the
+ * beacons of timesynch: the radio writes their time of departure in their
+ * last 2 bytes while they are being sent (CC2420_CONF_SFD_TIMESTAMPS), after
+ * the MIC has been computed, so a secured beacon would always be refused by
+ * the receivers. The beacons therefore go in clear. They are the only clear
+ * frames accepted: the others, and any clear frame not on the Rime channel of
+ * timesynch, are dropped here, and the nodes still refuse the commands that
+ * come in a frame without security (see node.c). A forged beacon can only
+ * shift the network time.
+ */
+
+#include "contiki.h"
+#include "net/packetbuf.h"
+#include "net/mac/framer-802154.h"
+#include "net/llsec/noncoresec/noncoresec.h"
+
+//Rime channel of the beacons (the one opened by timesynch.c)
+#ifdef SECURE_FRAMER_CONF_BEACON_CHANNEL
+#define BEACON_CHANNEL SECURE_FRAMER_CONF_BEACON_CHANNEL
+#else
+#define BEACON_CHANNEL 7
+#endif
+
+//security enabled bit of the frame control field
+#define FCF_SECURITY_ENABLED 0x08
+
+//1 if the frame in the packetbuf is a beacon of timesynch, sent in clear
+static int beacon(void) {
+	if (packetbuf_attr(PACKETBUF_ATTR_PACKET_TYPE)!=PACKETBUF_ATTR_PACKET_TYPE_TIMESTAMP)
+		return 0;
+	//noncoresec has set the security level of every outgoing frame
+	packetbuf_set_attr(PACKETBUF_ATTR_SECURITY_LEVEL, 0);
+	return 1;
+}
+
+static int length(void) {
+	return beacon()? framer_802154.length():noncoresec_framer.length();
+}
+
+static int create(void) {
+	return beacon()? framer_802154.create():noncoresec_framer.create();
+}
+
+static int parse(void) {
+	const uint8_t *frame = packetbuf_dataptr();
+	int hdrlen;
+
+	if (packetbuf_datalen()==0 || (frame[0] & FCF_SECURITY_ENABLED))
+		return noncoresec_framer.parse();
+
+	//in clear, only a beacon: the Rime header starts with the channel
+	hdrlen = framer_802154.parse();
+	frame = packetbuf_dataptr();
+	if (hdrlen<0 || packetbuf_datalen()<2 || (frame[0] | (frame[1]<<8))!=BEACON_CHANNEL)
+		return FRAMER_FAILED;
+	packetbuf_set_attr(PACKETBUF_ATTR_PACKET_TYPE, PACKETBUF_ATTR_PACKET_TYPE_TIMESTAMP);
+	return hdrlen;
+}
+
+const struct framer secure_framer = {length, create, parse};
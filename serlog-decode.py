@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+#
+# Expand the binary records of serlog (SERLOG_CONF_BINARY=1) read from the
+# serial port of a mote, e.g.:
+#
+#	make login TARGET=sky | ./serlog-decode.py
+#	./serlog-decode.py < capture.bin
+#
+# The formats are taken from serlog-events.h, so the decoder always matches
+# the firmware built from the same tree. Bytes outside the records (the boot
+# messages of Contiki) are copied as they are.
+
+import os
+import re
+import sys
+
+SYNC = 0xff
+
+def load_formats(path):
+	formats = []
+	with open(path) as f:
+		for line in f:
+			m = re.match(r'\s*X\((\w+),\s*"((?:[^"\\]|\\.)*)"\)', line)
+			if m:
+				formats.append(m.group(2).encode().decode('unicode_escape'))
+	return formats
+
+CONVERSION = re.compile(r'%([-+ #0-9]*)(l?)([a-z%])')
+
+def expand(fmt, args):
+	pos = 0
+
+	def convert(m):
+		nonlocal pos
+		flags, long, conv = m.groups()
+		if conv == '%':
+			return '%'
+		if conv == 's':
+			n = args[pos]
+			s = args[pos+1:pos+1+n].decode('latin-1')
+			pos += 1+n
+			return s
+		size = 4 if long else 2
+		if pos+size > len(args):
+			return '?'
+		signed = conv in 'dt'
+		value = int.from_bytes(args[pos:pos+size], 'little', signed=signed)
+		pos += size
+		if conv == 't':
+			return '%s%d.%d' % ('-' if value < 0 else '', abs(value)//10, abs(value)%10)
+		return ('%' + flags + conv) % value
+
+	return CONVERSION.sub(convert, fmt)
+
+def main():
+	here = os.path.dirname(os.path.abspath(__file__))
+	formats = load_formats(os.path.join(here, 'serlog-events.h'))
+	data = sys.stdin.buffer
+	out = sys.stdout
+
+	while True:
+		c = data.read(1)
+		if not c:
+			break
+		if c[0] != SYNC:
+			out.write(c.decode('latin-1'))
+			continue
+		header = data.read(2)
+		if len(header) < 2:
+			break
+		id, length = header
+		args = data.read(length)
+		if id < len(formats):
+			out.write(expand(formats[id], args))
+		else:
+			out.write('<unknown record %d>\n' % id)
+		out.flush()
+
+if __name__ == '__main__':
+	main()
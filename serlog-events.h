@@ -0,0 +1,102 @@
+/*
+ * Messages written on the serial port through serlog (see serlog.h): one
+ * X(identifier, format) per line. The host decoder (serlog-decode.py)
+ * parses this file to expand the binary records, so keep one message per line
+ * and append the new ones at the end: the identifiers of the old logs stay
+ * valid.
+ *
+ * Conversions: %d %u %x (16 bits), %ld %lu %lx (32 bits), %t (16 bits, a
+ * value in tenths printed with one decimal digit), %s (string, copied into the
+ * record), %% ; flags and width (%02x) are allowed.
+ */
+
+#ifndef SERLOG_EVENTS_H_
+#define SERLOG_EVENTS_H_
+
+#define SERLOG_EVENTS(X) \
+	X(LOG_BROADCAST_RECV, "broadcast message received from %u.%u\n") \
+	X(LOG_UNICAST_RECV, "unicast message received from %u.%u, seqno %u\n") \
+	X(LOG_UNICAST_SENT, "unicast message sent to %u.%u, retransmissions %u\n") \
+	X(LOG_UNICAST_TIMEDOUT, "unicast message timed out when sending to %u.%u, retransmissions %u\n") \
+	X(LOG_NODE_REGISTERED, "Node %u.%u registered (capabilities 0x%02x)\n") \
+	X(LOG_NO_ACK, "No acknowledgement of command %u from %u.%u\n") \
+	X(LOG_SCHEDULE_FULL, "Schedule full: action %u dropped\n") \
+	X(LOG_COMMAND, "Command: %d\n") \
+	X(LOG_SENDING_TEMP, "Sending temperature statistics to %u.%u\n") \
+	X(LOG_SENDING_LIGHT, "Sending light %d lux to %u.%u\n") \
+	X(LOG_SENDING_HISTORY, "Sending temperature history to %u.%u\n") \
+	X(LOG_HISTORY_TIMEDOUT, "history transfer timed out\n") \
+	X(LOG_SENDING_ENERGY, "Sending energy report to %u.%u\n") \
+	X(LOG_ENERGY_TRUNCATED, "Energy report truncated\n") \
+	X(LOG_STEAM_ON, "Steam room is switching on...\n") \
+	X(LOG_STEAM_OFF, "Steam room is switching off...\n") \
+	X(LOG_SENDING_TREATMENT, "Sending treatment %d to %u.%u\n") \
+	X(LOG_SENDING_STOP, "Sending stop treatment to %u.%u\n") \
+	X(LOG_COMMAND_NOT_FOUND, "Command not found\n") \
+	X(LOG_STEAM_SENSED, "Sensed temperature: %t C; sensed humidity: %t%%\n") \
+	X(LOG_STEAM_TOO_HOT, "Temperature is too high!\nSteam room is switching off...\n\n") \
+	X(LOG_STEAM_TOO_HUMID, "Humidity is too high!\nSteam room is switching off...\n\n") \
+	X(LOG_STEAM_TIMEOUT, "\nTimer expired!\nSteam room is switching off...\n\n") \
+	X(LOG_TEMP_AVG, "Temperature average: %t C\n") \
+	X(LOG_TEMP_MIN, "Temperature minimum: %t C\n") \
+	X(LOG_TEMP_MAX, "Temperature maximum: %t C\n") \
+	X(LOG_TEMP_VAR, "Temperature variance: %d.%02d C^2\n") \
+	X(LOG_TEMP_COUNT, "Temperature measurements: %d\n") \
+	X(LOG_LIGHT, "Outer light: %d lux\n") \
+	X(LOG_NO_TEMP, "\nNo temperature measurements available yet\n") \
+	X(LOG_CACHED, "\n(cached, %lu s old)\n") \
+	X(LOG_READINGS_UPDATED, "Readings of %u.%u updated\n") \
+	X(LOG_MALFORMED, "Malformed message from %u.%u\n") \
+	X(LOG_STEAM_AUTO_OFF, "\nThe steam room has been automatically turned off\n") \
+	X(LOG_ENERGY_REPORT, "\nEnergy report of %u.%u:\n") \
+	X(LOG_ENERGY, "%s: CPU %lu ms, LPM %lu ms, radio RX %lu ms, radio TX %lu ms\n") \
+	X(LOG_HISTORY_BEGIN, "\nTemperature history:\n") \
+	X(LOG_HISTORY_SAMPLE, "%lu s ago: %t C\n") \
+	X(LOG_HISTORY_END, "End of temperature history\n") \
+	X(LOG_GROUP_CONFIRMED, "\nCommand %u confirmed by all the %u nodes in %lu ms\n") \
+	X(LOG_GROUP_PARTIAL, "\nCommand %u confirmed by %u of %u nodes only (%lu ms)\n") \
+	X(LOG_SENDING_COMMAND, "Sending command to %u.%u\n") \
+	X(LOG_COMMAND_SENT, "Command %d sent to %d nodes\n") \
+	X(LOG_COMMAND_QUEUED, "Command %d queued (%d pending)\n") \
+	X(LOG_QUEUE_FULL, "\nQueue full: command %d to %u.%u dropped\n") \
+	X(LOG_TOO_MANY_GROUPS, "\nToo many unconfirmed commands: command %d dropped\n") \
+	X(LOG_NO_NODE, "\nNo node implements command %d yet\n") \
+	X(LOG_NOT_AVAILABLE, "\nCommand %d not available\n") \
+	X(LOG_MENU, "\nPOSSIBLE COMMANDS\n") \
+	X(LOG_MENU_ALARM_OFF, "1. Deactivate the alarm signal\n") \
+	X(LOG_MENU_ALARM_ON, "1. Activate the alarm signal\n") \
+	X(LOG_MENU_LOCK, "2. Lock the gate\n") \
+	X(LOG_MENU_UNLOCK, "2. Unlock the gate\n") \
+	X(LOG_MENU_GUEST, "3. Open (and automatically close) both the door and the gate in order to let a guest enter\n") \
+	X(LOG_MENU_TEMP, "4. Obtain the statistics of the last temperature values\n") \
+	X(LOG_MENU_LIGHT, "5. Obtain the external light value\n") \
+	X(LOG_MENU_STEAM_ON, "6. Switch steam room on\n") \
+	X(LOG_MENU_STEAM_OFF, "6. Switch steam room off\n") \
+	X(LOG_MENU_SAUNA_OFF, "6. Switch steam room off (working as sauna)\n") \
+	X(LOG_MENU_STEAM_BATH_OFF, "6. Switch steam room off (working as steam bath)\n") \
+	X(LOG_MENU_HISTORY, "7. Obtain the temperature history of the last %d minutes\n") \
+	X(LOG_MENU_ENERGY, "8. Obtain the energy report of the nodes\n\n") \
+	X(LOG_API_OK, "@%u ok %d %d\n") \
+	X(LOG_API_UNAVAILABLE, "@%u err unavailable %d\n") \
+	X(LOG_API_NO_NODE, "@%u err no-node %d\n") \
+	X(LOG_API_BUSY, "@%u err busy %d\n") \
+	X(LOG_API_SYNTAX, "@%u err syntax\n") \
+	X(LOG_API_PONG, "@%u ok ping\n") \
+	X(LOG_MENU_LONG_PRESS, "(a long press counts as %d presses)\n") \
+	X(LOG_TRACE, "trace %u.%u %lu %ld %u %u %u\n") \
+	X(LOG_TRACE_DUMP, "Trace of %u.%u: %u events\n") \
+	X(LOG_COMMAND_IN_CLEAR, "\nCommand from %u.%u in clear refused\n") \
+	X(LOG_OTA_RECEIVED, "Update of %u bytes received\n") \
+	X(LOG_OTA_INSTALLED, "Update installed: %u bytes, CRC %x\n") \
+	X(LOG_OTA_REFUSED, "\nUpdate refused: wrong %s\n") \
+	X(LOG_OTA_LOAD_FAILED, "\nUpdate not loaded (error %d), running the firmware in ROM\n") \
+	X(LOG_API_OTA, "@%u ok ota %d\n") \
+	X(LOG_API_OTA_ERR, "@%u err ota\n") \
+	X(LOG_TEMP_PERIOD, "Temperature sampling period: %u s\n") \
+	X(LOG_GROUP_TRUNCATED, "\nCommand %d waits only for the first %u nodes\n") \
+	X(LOG_LOST, "(%u log records lost)\n") \
+	X(LOG_WRONG_ADDR, "\nWarning: address %u.%u, this firmware is for %u.0\n") \
+	X(LOG_OTA_NOT_SAVED, "\nUpdate refused: the active slot could not be written\n") \
+	X(LOG_SEND_DEFERRED, "\nFrame to %u.%u not accepted by the radio, retrying\n")
+
+#endif /* SERLOG_EVENTS_H_ */
@@ -0,0 +1,216 @@
+/*
+ * Implementation of the non-blocking serial log (see serlog.h).
+ */
+
+#include "serlog.h"
+#include "lib/ringbuf.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SERLOG_FORMAT(id, format) format,
+static const char *const formats[] = {SERLOG_EVENTS(SERLOG_FORMAT)};
+
+static struct ringbuf ring;
+static uint8_t ring_data[SERLOG_SIZE];
+//records dropped because the buffer was full, not logged yet
+static uint16_t lost = 0;
+
+PROCESS(serlog_process, "Serial log");
+
+//skip the flags and the width of a conversion
+static const char *skip_flags(const char *f) {
+	while (*f!='\0' && strchr("-+ #0123456789", *f)!=NULL)
+		f++;
+	return f;
+}
+
+static void put_uint(uint8_t *buf, uint32_t value, int len) {
+	int i;
+
+	for (i=0; i<len; i++, value>>=8)
+		buf[i] = value & 0xff;
+}
+
+static uint32_t get_uint(const uint8_t *buf, int len) {
+	uint32_t value = 0;
+
+	while (len-->0)
+		value = value<<8 | buf[len];
+	return value;
+}
+
+//free bytes of the ring buffer
+static int room(void) {
+	return SERLOG_SIZE-1-ringbuf_elements(&ring);
+}
+
+//record of LOG_LOST
+#define LOST_LEN 4
+
+static void put_lost(void) {
+	ringbuf_put(&ring, LOG_LOST);
+	ringbuf_put(&ring, 2);
+	ringbuf_put(&ring, lost & 0xff);
+	ringbuf_put(&ring, lost >> 8);
+	lost = 0;
+}
+
+void serlog(uint8_t id, ...) {
+	uint8_t record[SERLOG_MAX_RECORD];
+	uint8_t len = 2;
+	const char *f, *s;
+	va_list ap;
+	int i, n;
+
+	//only copy the raw arguments, the format tells their size
+	va_start(ap, id);
+	for (f=formats[id]; *f!='\0'; f++) {
+		if (*f!='%' || *++f=='%')
+			continue;
+		f = skip_flags(f);
+		if (*f=='\0')
+			break;
+		if (*f=='l') {
+			f++;
+			if (len+4<=SERLOG_MAX_RECORD) {
+				put_uint(&record[len], va_arg(ap, unsigned long), 4);
+				len += 4;
+			}
+		} else if (*f=='s') {
+			s = va_arg(ap, const char*);
+			n = strlen(s);
+			if (n>SERLOG_MAX_RECORD-len-1)
+				n = SERLOG_MAX_RECORD-len-1;
+			if (n>=0) {
+				record[len++] = n;
+				memcpy(&record[len], s, n);
+				len += n;
+			}
+		} else if (len+2<=SERLOG_MAX_RECORD) {
+			put_uint(&record[len], va_arg(ap, unsigned int), 2);
+			len += 2;
+		}
+	}
+	va_end(ap);
+	record[0] = id;
+	record[1] = len-2;
+
+	//report the records lost before this one first
+	if (lost>0 && room()>=LOST_LEN+len)
+		put_lost();
+	if (room()<len)
+		lost++;
+	else {
+		for (i=0; i<len; i++)
+			ringbuf_put(&ring, record[i]);
+	}
+	process_poll(&serlog_process);
+}
+
+#if !SERLOG_BINARY
+//print a record with the format of its message
+static void expand(uint8_t id, const uint8_t *arg) {
+	char spec[8];
+	const char *f, *start;
+	int16_t tenths;
+	int i, n;
+
+	for (f=formats[id]; *f!='\0'; f++) {
+		if (*f!='%') {
+			putchar(*f);
+			continue;
+		}
+		if (f[1]=='%') {
+			putchar('%');
+			f++;
+			continue;
+		}
+
+		//rebuild the conversion specification for printf()
+		start = f;
+		f = skip_flags(f+1);
+		if (*f=='l')
+			f++;
+		n = f-start+1;
+		if (n>=sizeof(spec))
+			n = sizeof(spec)-1;
+		memcpy(spec, start, n);
+		spec[n] = '\0';
+
+		if (*f=='t') {
+			tenths = get_uint(arg, 2);
+			arg += 2;
+			if (tenths<0) {
+				putchar('-');
+				tenths = -tenths;
+			}
+			printf("%d.%d", tenths/10, tenths%10);
+		} else if (*f=='s') {
+			for (i=0; i<arg[0]; i++)
+				putchar(arg[1+i]);
+			arg += 1+arg[0];
+		} else if (f[-1]=='l') {
+			if (*f=='d')
+				printf(spec, (long)(int32_t)get_uint(arg, 4));
+			else
+				printf(spec, (unsigned long)get_uint(arg, 4));
+			arg += 4;
+		} else {
+			if (*f=='d')
+				printf(spec, (int)(int16_t)get_uint(arg, 2));
+			else
+				printf(spec, (unsigned int)get_uint(arg, 2));
+			arg += 2;
+		}
+	}
+}
+#endif
+
+//write out the oldest record, returns 0 if there is none
+static int drain(void) {
+	uint8_t record[SERLOG_MAX_RECORD];
+	int c, i;
+
+	if ((c = ringbuf_get(&ring))<0)
+		return 0;
+	record[0] = c;
+	record[1] = ringbuf_get(&ring);
+	for (i=0; i<record[1]; i++)
+		record[2+i] = ringbuf_get(&ring);
+
+#if SERLOG_BINARY
+	putchar(SERLOG_SYNC);
+	for (i=0; i<2+record[1]; i++)
+		putchar(record[i]);
+#else
+	expand(record[0], &record[2]);
+#endif
+	return 1;
+}
+
+void serlog_flush(void) {
+	while (drain());
+}
+
+void serlog_init(void) {
+	ringbuf_init(&ring, ring_data, SERLOG_SIZE);
+	process_start(&serlog_process, NULL);
+}
+
+PROCESS_THREAD(serlog_process, ev, data) {
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_YIELD_UNTIL(ev==PROCESS_EVENT_POLL);
+		//one record at a time, so that the other processes run in between
+		if (drain())
+			process_poll(&serlog_process);
+		else if (lost>0) {
+			put_lost();
+			process_poll(&serlog_process);
+		}
+	}
+
+	PROCESS_END();
+}
@@ -0,0 +1,62 @@
+/*
+ * Non-blocking serial log.
+ *
+ * printf() writes every character on the UART before returning, so a line
+ * printed by a radio callback holds the network stack for milliseconds. The
+ * messages are instead identified by the LOG_* codes of serlog-events.h:
+ * serlog() only copies the code and the raw arguments in a ring buffer
+ * (Contiki's ringbuf), and a process writes the records out one at a time
+ * when the node has nothing else to do. Nothing is formatted by the caller.
+ *
+ * In text mode (default) the process expands every record with its format,
+ * so the output is the same as with printf. In binary mode (SERLOG_CONF_BINARY)
+ * the records are written as they are, preceded by SERLOG_SYNC, and are
+ * expanded on the host by serlog-decode.py: the mote never formats any
+ * text at all. serlog() never waits for the UART: when the buffer is full the
+ * record is dropped, and the number of records lost is logged (LOG_LOST) as
+ * soon as there is room again.
+ *
+ * Record: code (1 byte), length of the arguments (1 byte), arguments
+ * (little-endian, 2 or 4 bytes each, strings as length and characters).
+ */
+
+#ifndef SERLOG_H_
+#define SERLOG_H_
+
+#include "contiki.h"
+#include "serlog-events.h"
+
+#ifdef SERLOG_CONF_BINARY
+#define SERLOG_BINARY SERLOG_CONF_BINARY
+#else
+#define SERLOG_BINARY 0
+#endif
+
+//bytes of the ring buffer: a power of 2, at most 128 (lib/ringbuf.h)
+#ifdef SERLOG_CONF_SIZE
+#define SERLOG_SIZE SERLOG_CONF_SIZE
+#else
+#define SERLOG_SIZE 128
+#endif
+
+//longest record, strings are cut to fit
+#define SERLOG_MAX_RECORD 40
+
+//first byte of the records in binary mode (never found in the text)
+#define SERLOG_SYNC 0xff
+
+#define SERLOG_ID(id, format) id,
+enum {
+	SERLOG_EVENTS(SERLOG_ID)
+	SERLOG_COUNT
+};
+
+void serlog_init(void);
+
+/* Log the message with the given code; the arguments match its format. */
+void serlog(uint8_t id, ...);
+
+/* Write out all the pending records before returning. */
+void serlog_flush(void);
+
+#endif /* SERLOG_H_ */
@@ -0,0 +1,30 @@
+/*
+ * Cooja ScriptRunner test for Sht11Bench: measures the MSP430 cycles spent by
+ * the double and by the fixed-point SHT11 conversions.
+ *
+ * Run headless with
+ * 		java -jar cooja.jar -nogui=sht11-bench.csc -contiki=<contiki dir>
+ * the result is written to COOJA.testlog.
+ */
+
+TIMEOUT(60000);
+
+var ITERATIONS = 100;
+var start = {};
+var cycles = {};
+
+while (true) {
+	var m = msg.match(/^BENCH (\w+) (start|end)/);
+	if (m) {
+		if (m[2] == "start")
+			start[m[1]] = mote.getCPU().cycles;
+		else
+			cycles[m[1]] = (mote.getCPU().cycles-start[m[1]])/ITERATIONS;
+	} else if (msg.startsWith("BENCH done")) {
+		log.log("old:   " + cycles["old"] + " cycles per conversion\n");
+		log.log("fixed: " + cycles["fixed"] + " cycles per conversion\n");
+		log.log("speedup: " + (cycles["old"]/cycles["fixed"]).toFixed(1) + "x\n");
+		log.testOK();
+	}
+	YIELD();
+}
@@ -0,0 +1,19 @@
+/*
+ * Implementation of the SHT11 conversions (see sht11-conv.h).
+ */
+
+#include "sht11-conv.h"
+
+int16_t sht11_conv_temp(uint16_t raw) {
+	/*10*T = SOt/10 - 396, with SOt/10 computed as SOt*26215/2^18 (the error
+	 is below 0.04, so the result is the same as the integer division)*/
+	return (int16_t)(((uint32_t)raw*26215) >> 18)-396;
+}
+
+int16_t sht11_conv_humidity(uint16_t raw) {
+	/*10*RH = -40 + 0.405*SOrh - 2.8e-5*SOrh^2, with
+	 0.405 = 26542/2^16 and 2.8e-5 = 15032/2^29 (SOrh^2 is shifted first so
+	 that the product fits in 32 bits for any raw value below 2^14)*/
+	return -40+(int16_t)(((uint32_t)raw*26542) >> 16)
+			-(int16_t)(((((uint32_t)raw*raw) >> 10)*15032) >> 19);
+}
@@ -0,0 +1,27 @@
+/*
+ * Integer conversion of the raw SHT11 readings, shared by Node1 and Node4.
+ *
+ * The datasheet formulas (14-bit temperature, 12-bit humidity, VDD = 3 V)
+ * 		T  = -39.6 + 0.01*SOt
+ * 		RH = -4 + 0.0405*SOrh - 2.8e-6*SOrh^2
+ * are evaluated with 32-bit integer multiplications and shifts only: on the
+ * MSP430 of the sky mote there is no FPU, and the double constants used before
+ * pulled in the soft-float library and cost thousands of cycles per sample.
+ *
+ * Both results are fixed-point values with one decimal digit.
+ */
+
+#ifndef SHT11_CONV_H_
+#define SHT11_CONV_H_
+
+#include "contiki.h"
+
+/* Temperature in tenths of C. */
+int16_t sht11_conv_temp(uint16_t raw);
+
+/* Relative humidity in tenths of %. The result is not clamped to 0..100%:
+ the simulated sensor of Cooja returns values above 100%, and the nodes rely
+ on that to work next to their thresholds. Valid for raw < 2^14. */
+int16_t sht11_conv_humidity(uint16_t raw);
+
+#endif /* SHT11_CONV_H_ */
@@ -0,0 +1,155 @@
+/*
+ * Implementation of the shared SHT11 sampling service (see sht11-sampler.h).
+ */
+
+#include "sht11-sampler.h"
+#include "sht11-conv.h"
+#include "dev/sht11/sht11-sensor.h"
+#include "trace.h"
+
+#define SAMPLER_ALL (SHT11_SAMPLER_TEMP | SHT11_SAMPLER_HUMIDITY)
+
+process_event_t sht11_sampler_event;
+
+//processes waiting for a sample and the quantities they want
+static struct {
+	struct process *p;
+	uint8_t what;
+} consumers[SHT11_SAMPLER_CONSUMERS];
+
+static uint16_t raw_temp, raw_humidity;
+static clock_time_t temp_stamp, humidity_stamp;
+static uint8_t valid = 0; //quantities measured at least once
+
+PROCESS(sht11_sampler_process, "SHT11 sampler");
+
+void sht11_sampler_init(void) {
+	//events are allocated from PROCESS_EVENT_MAX on, so 0 means not yet
+	if (sht11_sampler_event==0)
+		sht11_sampler_event = process_alloc_event();
+	if (!process_is_running(&sht11_sampler_process))
+		process_start(&sht11_sampler_process, NULL);
+}
+
+int sht11_sampler_request(struct process *p, uint8_t what) {
+	int i, slot = -1;
+
+	for (i=0; i<SHT11_SAMPLER_CONSUMERS; i++) {
+		if (consumers[i].p==p) {
+			slot = i;
+			break;
+		}
+		if (consumers[i].p==NULL && slot<0)
+			slot = i;
+	}
+	if (slot<0)
+		return 0;
+
+	consumers[slot].p = p;
+	consumers[slot].what = what;
+	process_poll(&sht11_sampler_process);
+	return 1;
+}
+
+void sht11_sampler_cancel(struct process *p) {
+	int i;
+
+	for (i=0; i<SHT11_SAMPLER_CONSUMERS; i++)
+		if (consumers[i].p==p)
+			consumers[i].p = NULL;
+}
+
+//quantities in what whose cached value cannot be used any more
+static uint8_t stale(uint8_t what) {
+	uint8_t s = 0;
+	clock_time_t now = clock_time();
+
+	if ((what & SHT11_SAMPLER_TEMP) && (!(valid & SHT11_SAMPLER_TEMP)
+			|| now-temp_stamp >= SHT11_SAMPLER_MAX_AGE))
+		s |= SHT11_SAMPLER_TEMP;
+	if ((what & SHT11_SAMPLER_HUMIDITY) && (!(valid & SHT11_SAMPLER_HUMIDITY)
+			|| now-humidity_stamp >= SHT11_SAMPLER_MAX_AGE))
+		s |= SHT11_SAMPLER_HUMIDITY;
+	return s;
+}
+
+static uint8_t pending(void) {
+	uint8_t what = 0;
+	int i;
+
+	for (i=0; i<SHT11_SAMPLER_CONSUMERS; i++)
+		if (consumers[i].p!=NULL)
+			what |= consumers[i].what;
+	return what;
+}
+
+//notify the consumers whose quantities are all in fresh
+static void deliver(uint8_t fresh) {
+	int i;
+
+	for (i=0; i<SHT11_SAMPLER_CONSUMERS; i++) {
+		if (consumers[i].p!=NULL && (consumers[i].what & ~fresh)==0) {
+			process_post(consumers[i].p, sht11_sampler_event, NULL);
+			consumers[i].p = NULL;
+		}
+	}
+}
+
+PROCESS_THREAD(sht11_sampler_process, ev, data) {
+	static uint8_t what;
+
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_WAIT_EVENT_UNTIL(ev==PROCESS_EVENT_POLL);
+
+		//answer from the cache whoever does not need a new conversion
+		deliver(SAMPLER_ALL & ~stale(SAMPLER_ALL));
+		what = stale(pending());
+		if (what==0)
+			continue;
+
+		SENSORS_ACTIVATE(sht11_sensor);
+		if (what & SHT11_SAMPLER_TEMP) {
+			raw_temp = sht11_sensor.value(SHT11_SENSOR_TEMP);
+			temp_stamp = clock_time();
+			TRACE_DETAIL(TRACE_SAMPLE, TRACE_SENSOR_TEMP, raw_temp);
+			if (what & SHT11_SAMPLER_HUMIDITY) {
+				//let the other processes run between the two conversions
+				process_poll(&sht11_sampler_process);
+				PROCESS_WAIT_EVENT_UNTIL(ev==PROCESS_EVENT_POLL);
+			}
+		}
+		if (what & SHT11_SAMPLER_HUMIDITY) {
+			raw_humidity = sht11_sensor.value(SHT11_SENSOR_HUMIDITY);
+			humidity_stamp = clock_time();
+			TRACE_DETAIL(TRACE_SAMPLE, TRACE_SENSOR_HUMIDITY, raw_humidity);
+		}
+		SENSORS_DEACTIVATE(sht11_sensor);
+		valid |= what;
+
+		deliver(what | (SAMPLER_ALL & ~stale(SAMPLER_ALL)));
+
+		//requests arrived during the acquisition may need another cycle
+		if (pending())
+			process_poll(&sht11_sampler_process);
+	}
+
+	PROCESS_END();
+}
+
+uint16_t sht11_sampler_raw_temp(void) {
+	return raw_temp;
+}
+
+uint16_t sht11_sampler_raw_humidity(void) {
+	return raw_humidity;
+}
+
+int16_t sht11_sampler_temp(void) {
+	return sht11_conv_temp(raw_temp);
+}
+
+int16_t sht11_sampler_humidity(void) {
+	return sht11_conv_humidity(raw_humidity);
+}
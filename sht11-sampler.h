@@ -0,0 +1,64 @@
+/*
+ * Shared SHT11 sampling service.
+ *
+ * A process asks for a sample with sht11_sampler_request() and keeps running:
+ * the sampler performs the acquisition in its own process and posts
+ * sht11_sampler_event to every process that is waiting for it. Each quantity
+ * is converted at most once per cycle, the raw values are cached, and a
+ * request is answered from the cache (without touching the sensor) when the
+ * cached values are younger than SHT11_SAMPLER_MAX_AGE:
+ * 		sht11_sampler_request(PROCESS_CURRENT(), SHT11_SAMPLER_TEMP);
+ * 		PROCESS_WAIT_EVENT_UNTIL(ev==sht11_sampler_event);
+ * 		temp = sht11_sampler_temp();
+ *
+ * The sensor is powered only for the duration of an acquisition, and the
+ * sampler yields between the temperature and the humidity conversion so that
+ * the other processes are not held for both of them.
+ */
+
+#ifndef SHT11_SAMPLER_H_
+#define SHT11_SAMPLER_H_
+
+#include "contiki.h"
+
+//quantities a process can ask for
+#define SHT11_SAMPLER_TEMP 0x01
+#define SHT11_SAMPLER_HUMIDITY 0x02
+
+//cached values younger than this (clock ticks) are not measured again
+#ifdef SHT11_SAMPLER_CONF_MAX_AGE
+#define SHT11_SAMPLER_MAX_AGE SHT11_SAMPLER_CONF_MAX_AGE
+#else
+#define SHT11_SAMPLER_MAX_AGE CLOCK_SECOND
+#endif
+
+//number of processes that can wait for a sample at the same time
+#ifdef SHT11_SAMPLER_CONF_CONSUMERS
+#define SHT11_SAMPLER_CONSUMERS SHT11_SAMPLER_CONF_CONSUMERS
+#else
+#define SHT11_SAMPLER_CONSUMERS 2
+#endif
+
+extern process_event_t sht11_sampler_event;
+
+PROCESS_NAME(sht11_sampler_process);
+
+/* Start the sampler (can be called more than once). */
+void sht11_sampler_init(void);
+
+/* Ask for the quantities in what: sht11_sampler_event is posted to p when
+ they are available. Returns 0 if there is no room for another consumer. */
+int sht11_sampler_request(struct process *p, uint8_t what);
+
+/* Withdraw the request of p, if any: nothing is posted to it any more. */
+void sht11_sampler_cancel(struct process *p);
+
+/* Latest raw readings. */
+uint16_t sht11_sampler_raw_temp(void);
+uint16_t sht11_sampler_raw_humidity(void);
+
+/* Latest readings in tenths of C and tenths of % (see sht11-conv.h). */
+int16_t sht11_sampler_temp(void);
+int16_t sht11_sampler_humidity(void);
+
+#endif /* SHT11_SAMPLER_H_ */
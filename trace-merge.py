@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+#
+# Merge the trace dumps (command 9, see trace.h) of all the nodes into a single
+# timeline, from the serial output of the CU, e.g.:
+#
+#	./trace-merge.py cu.log
+#	make login TARGET=sky | ./serlog-decode.py | ./trace-merge.py
+#
+# The CU prints every event with the time of the node and the same time on the
+# clock of the CU, so the events of different nodes can be sorted together. The
+# rings are not cleared by a dump: an event found in several dumps is shown
+# once. Timestamps are in seconds on the clock of the CU.
+
+import fileinput
+import re
+
+LINE = re.compile(r'trace (\d+)\.(\d+) (\d+) (-?\d+) (\d+) (\d+) (\d+)$')
+
+SENSORS = {1: 'temperature (raw)', 2: 'humidity (raw)', 3: 'light'}
+
+def process_name(value):
+	if value == 0:
+		return '?'
+	return (chr(value & 0xff) + chr(value >> 8)).strip('\0')
+
+def describe(type, arg, value):
+	if type == 1:
+		if arg == 0:
+			return 'tx broadcast ch %d' % value
+		return 'tx to %d ch %d' % (arg, value)
+	if type == 2:
+		return 'rx from %d ch %d' % (arg, value)
+	if type == 3:
+		return 'retransmission %d to %d' % (value, arg)
+	if type == 4:
+		return 'timeout to %d after %d retransmissions' % (arg, value)
+	if type == 5:
+		return 'start "%s..."' % process_name(value)
+	if type == 6:
+		return 'exit "%s..."' % process_name(value)
+	if type == 7:
+		return 'sample %s %d' % (SENSORS.get(arg, 'sensor %d' % arg), value)
+	return 'event %d %d %d' % (type, arg, value)
+
+def main():
+	events = {}
+
+	for line in fileinput.input():
+		m = LINE.search(line.strip())
+		if not m:
+			continue
+		a, b, local, aligned, type, arg, value = map(int, m.groups())
+		key = (a, b, local, type, arg, value)
+		#keep the first estimate of the time on the CU
+		events.setdefault(key, aligned)
+
+	for key, aligned in sorted(events.items(), key=lambda e: (e[1], e[0])):
+		a, b, local, type, arg, value = key
+		print('%10.3f  %d.%d  %s' % (aligned/1000, a, b, describe(type, arg, value)))
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,160 @@
+/*
+ * Implementation of the binary trace (see trace.h).
+ */
+
+#include "trace.h"
+#include "message.h"
+#include "transport.h"
+#include "serlog.h"
+
+#define TRACE_RETRANSMISSIONS 3
+
+//time between two checks of the transport while a dump waits for it
+#define TRACE_POLL_INTERVAL (CLOCK_SECOND/8)
+
+struct trace_event {
+	uint32_t time;
+	uint8_t type;
+	uint8_t arg;
+	uint16_t value;
+};
+
+static struct trace_event ring[TRACE_SIZE];
+static uint8_t head = 0;	//next event written
+static uint8_t count = 0;
+static uint8_t dumping = 0;
+static linkaddr_t dump_to;
+
+PROCESS(trace_process, "Trace");
+
+//clock ticks since boot, on 32 bits (clock_time() wraps after 512 s on sky)
+static uint32_t trace_time(void) {
+	return (uint32_t)clock_seconds()*CLOCK_SECOND + clock_time()%CLOCK_SECOND;
+}
+
+static unsigned long ticks_to_ms(uint32_t ticks) {
+	return ticks/CLOCK_SECOND*1000 + ticks%CLOCK_SECOND*1000/CLOCK_SECOND;
+}
+
+void trace_add(uint8_t type, uint8_t arg, uint16_t value) {
+	struct trace_event *e = &ring[head];
+
+	if (dumping)
+		return;
+	e->time = trace_time();
+	e->type = type;
+	e->arg = arg;
+	e->value = value;
+	head = (head+1)%TRACE_SIZE;
+	if (count<TRACE_SIZE)
+		count++;
+}
+
+uint16_t trace_process_id(struct process *p) {
+	const char *name = PROCESS_NAME_STRING(p);
+
+	if (name[0]=='\0')
+		return 0;
+	return name[0] | name[1]<<8;
+}
+
+/*
+ * Write in buf the clock of the node and the events from the first-th oldest
+ * one, at most TRACE_PER_FRAME of them. Returns the length of the body.
+ */
+static uint8_t build_chunk(uint8_t *buf, uint16_t first) {
+	const struct trace_event *e;
+	uint8_t len = 4;
+	uint16_t i;
+
+	msg_put_uint32(buf, trace_time());
+	for (i=first; i<count && i<first+TRACE_PER_FRAME; i++) {
+		e = &ring[(head+TRACE_SIZE-count+i)%TRACE_SIZE];
+		msg_put_uint32(&buf[len], e->time);
+		buf[len+4] = e->type;
+		buf[len+5] = e->arg;
+		buf[len+6] = e->value & 0xff;
+		buf[len+7] = e->value >> 8;
+		len += TRACE_EVENT_LEN;
+	}
+	return len;
+}
+
+void trace_print(const linkaddr_t *from, const uint8_t *value, uint8_t len) {
+	uint32_t now = trace_time();
+	uint32_t node_now, time;
+	int32_t aligned;
+	uint8_t i;
+
+	if (len<4)
+		return;
+	node_now = msg_get_uint32(value);
+	for (i=4; i+TRACE_EVENT_LEN<=len; i+=TRACE_EVENT_LEN) {
+		time = msg_get_uint32(&value[i]);
+		//the event happened node_now-time ticks before the frame was built
+		aligned = now-(node_now-time);
+		serlog(LOG_TRACE, from->u8[0], from->u8[1], ticks_to_ms(time),
+				(aligned<0)? -(long)ticks_to_ms(-aligned):(long)ticks_to_ms(aligned),
+				value[i+4], value[i+5], value[i+6] | value[i+7]<<8);
+	}
+}
+
+void trace_dump(const linkaddr_t *to) {
+	uint8_t body[4+TRACE_PER_FRAME*TRACE_EVENT_LEN];
+	//16 bits: with TRACE_SIZE close to 255 it goes past the ring
+	uint16_t first = 0;
+
+	if (to!=NULL) {
+		linkaddr_copy(&dump_to, to);
+		process_poll(&trace_process);
+		return;
+	}
+
+	serlog(LOG_TRACE_DUMP, linkaddr_node_addr.u8[0], linkaddr_node_addr.u8[1], count);
+	for (first=0; first<count; first+=TRACE_PER_FRAME)
+		trace_print(&linkaddr_node_addr, body, build_chunk(body, first));
+}
+
+void trace_init(void) {
+	process_start(&trace_process, NULL);
+}
+
+PROCESS_THREAD(trace_process, ev, data) {
+	static struct etimer et;
+	static uint16_t sent;
+	uint8_t body[4+TRACE_PER_FRAME*TRACE_EVENT_LEN];
+
+	PROCESS_BEGIN();
+
+	while(1) {
+		PROCESS_WAIT_EVENT();
+		if (ev==PROCESS_EVENT_EXITED) {
+			TRACE_DETAIL(TRACE_PROCESS_EXIT, 0, trace_process_id(data));
+			continue;
+		} else if (ev!=PROCESS_EVENT_POLL || dumping)
+			continue;
+
+		//send the ring to the CU, at least one (maybe empty) record
+		dumping = 1;
+		sent = 0;
+		do {
+			//the transport is shared with the replies of the node
+			while (transport_is_transmitting()) {
+				etimer_set(&et, TRACE_POLL_INTERVAL);
+				PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+			}
+			msg_init(MSG_READING);
+			msg_add(READING_TRACE, body, build_chunk(body, sent));
+			transport_send(&dump_to, TRACE_RETRANSMISSIONS);
+			sent += TRACE_PER_FRAME;
+		} while (sent<count);
+
+		while (transport_is_transmitting()) {
+			etimer_set(&et, TRACE_POLL_INTERVAL);
+			PROCESS_WAIT_EVENT_UNTIL(etimer_expired(&et));
+		}
+		dumping = 0;
+	}
+
+	PROCESS_END();
+}
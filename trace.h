@@ -0,0 +1,109 @@
+/*
+ * Binary trace of the radio and process events of a node.
+ *
+ * Every node keeps its last TRACE_SIZE events in a ring in RAM, so they can be
+ * read after the fact even if nobody was watching the serial port. An event is
+ * 8 bytes: a timestamp (clock ticks since boot, 32 bits), a TRACE_* type, a
+ * 1-byte argument (usually the first byte of the Rime address of the peer)
+ * and a 2-byte value. Recording an event is a few stores in the ring: nothing
+ * is formatted and nothing is written on the serial port.
+ *
+ * The hooks are macros, so the events above TRACE_LEVEL (compile time,
+ * TRACE_CONF_LEVEL) cost nothing at all:
+ * 		TRACE_LEVEL_ERRORS	retransmissions and timeouts
+ * 		TRACE_LEVEL_RADIO	+ every frame sent and received
+ * 		TRACE_LEVEL_ALL		+ process start/exit and sensor samples
+ *
+ * Command 9 of the CU dumps the rings: the CU prints its own at once, the nodes
+ * send theirs to the CU as READING_TRACE records, a few events per frame
+ * (TRACE_PER_FRAME), and the CU prints them as well. Every line carries the
+ * time of the event on the node and the same time on the clock of the CU,
+ * estimated from the clock of the node when the frame was built, so
+ * trace-merge.py can sort the dumps of all the nodes in a single timeline.
+ * The ring is not cleared by a dump, and it does not record while a dump is in
+ * progress, so that the dump does not trace itself.
+ *
+ * Process starts are recorded by TRACE_BEGIN() after PROCESS_BEGIN(), exits of
+ * any process by the trace process itself (PROCESS_EVENT_EXITED). Processes
+ * are identified by the first two characters of their name.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+#define TRACE_LEVEL_OFF 0
+#define TRACE_LEVEL_ERRORS 1
+#define TRACE_LEVEL_RADIO 2
+#define TRACE_LEVEL_ALL 3
+
+#ifdef TRACE_CONF_LEVEL
+#define TRACE_LEVEL TRACE_CONF_LEVEL
+#else
+#define TRACE_LEVEL TRACE_LEVEL_ALL
+#endif
+
+//events kept in the ring (8 bytes each), at most 255
+#ifdef TRACE_CONF_SIZE
+#define TRACE_SIZE TRACE_CONF_SIZE
+#else
+#define TRACE_SIZE 32
+#endif
+#if TRACE_SIZE>255
+#error "TRACE_SIZE must be at most 255"
+#endif
+
+//events in a READING_TRACE record, after the 4-byte clock of the node
+#define TRACE_PER_FRAME 9
+#define TRACE_EVENT_LEN 8
+
+//event types: argument, value
+#define TRACE_TX 1				//peer (0 for a broadcast), channel
+#define TRACE_RX 2				//peer, channel
+#define TRACE_RETRANSMISSION 3	//peer, retransmissions so far
+#define TRACE_TIMEOUT 4			//peer, retransmissions
+#define TRACE_PROCESS_START 5	//0, first two characters of the name
+#define TRACE_PROCESS_EXIT 6	//0, first two characters of the name
+#define TRACE_SAMPLE 7			//TRACE_SENSOR_*, value (raw or converted)
+
+#define TRACE_SENSOR_TEMP 1			//raw SHT11 temperature
+#define TRACE_SENSOR_HUMIDITY 2		//raw SHT11 humidity
+#define TRACE_SENSOR_LIGHT 3		//lux
+
+#if TRACE_LEVEL>=TRACE_LEVEL_ERRORS
+#define TRACE_ERROR(type, arg, value) trace_add(type, arg, value)
+#else
+#define TRACE_ERROR(type, arg, value)
+#endif
+
+#if TRACE_LEVEL>=TRACE_LEVEL_RADIO
+#define TRACE_RADIO(type, arg, value) trace_add(type, arg, value)
+#else
+#define TRACE_RADIO(type, arg, value)
+#endif
+
+#if TRACE_LEVEL>=TRACE_LEVEL_ALL
+#define TRACE_DETAIL(type, arg, value) trace_add(type, arg, value)
+#else
+#define TRACE_DETAIL(type, arg, value)
+#endif
+
+#define TRACE_BEGIN() \
+	TRACE_DETAIL(TRACE_PROCESS_START, 0, trace_process_id(PROCESS_CURRENT()))
+
+void trace_init(void);
+
+/* Record an event (use the TRACE_* macros instead). */
+void trace_add(uint8_t type, uint8_t arg, uint16_t value);
+
+uint16_t trace_process_id(struct process *p);
+
+/* Node: send the ring to the CU. CU: print the ring (to==NULL). */
+void trace_dump(const linkaddr_t *to);
+
+/* CU: print the events of a READING_TRACE record received from a node. */
+void trace_print(const linkaddr_t *from, const uint8_t *value, uint8_t len);
+
+#endif /* TRACE_H_ */
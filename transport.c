@@ -0,0 +1,210 @@
+/*
+ * Implementation of the reliable unicast transport (see transport.h).
+ */
+
+#include "transport.h"
+#include "trace.h"
+#include <string.h>
+
+static const struct transport_callbacks *callbacks;
+static uint16_t channel;
+
+void transport_sink(linkaddr_t *addr) {
+	addr->u8[0] = TRANSPORT_SINK;
+	addr->u8[1] = 0;
+}
+
+#if TRANSPORT_MESH
+
+#define TRANSPORT_DATA 0
+#define TRANSPORT_ACK 1
+
+struct transport_hdr {
+	uint8_t type;
+	uint8_t seqno;
+} __attribute__((packed));
+
+static struct mesh_conn mesh;
+static struct ctimer retransmit_timer;
+
+//frame in flight, kept until it is acknowledged
+static struct queuebuf *pending = NULL;
+static linkaddr_t pending_to;
+static uint8_t pending_seqno;
+static uint8_t retransmissions, max_retransmissions;
+static uint8_t seqno = 0;
+
+//last sequence number received from the latest senders
+static struct {
+	linkaddr_t from;
+	uint8_t seqno;
+	uint8_t valid;
+} peers[TRANSPORT_PEERS];
+static uint8_t next_peer = 0;
+
+static void send_pending(void);
+
+static void retransmit(void *ptr) {
+	if (retransmissions>=max_retransmissions) {
+		queuebuf_free(pending);
+		pending = NULL;
+		TRACE_ERROR(TRACE_TIMEOUT, pending_to.u8[0], retransmissions);
+		callbacks->timedout(&pending_to, retransmissions);
+		return;
+	}
+	retransmissions++;
+	TRACE_ERROR(TRACE_RETRANSMISSION, pending_to.u8[0], retransmissions);
+	send_pending();
+}
+
+static void send_pending(void) {
+	queuebuf_to_packetbuf(pending);
+	//a route discovery may be needed first: the frame is then queued by mesh
+	mesh_send(&mesh, &pending_to);
+	TRACE_RADIO(TRACE_TX, pending_to.u8[0], channel);
+	ctimer_set(&retransmit_timer, TRANSPORT_TIMEOUT, retransmit, NULL);
+}
+
+//returns 1 if the frame has already been received (its ack was lost)
+static int duplicate(const linkaddr_t *from, uint8_t seqno) {
+	int i;
+
+	for (i=0; i<TRANSPORT_PEERS; i++) {
+		if (peers[i].valid && linkaddr_cmp(&peers[i].from, from)) {
+			if (peers[i].seqno==seqno)
+				return 1;
+			peers[i].seqno = seqno;
+			return 0;
+		}
+	}
+
+	//a new sender replaces the oldest one
+	linkaddr_copy(&peers[next_peer].from, from);
+	peers[next_peer].seqno = seqno;
+	peers[next_peer].valid = 1;
+	next_peer = (next_peer+1)%TRANSPORT_PEERS;
+	return 0;
+}
+
+static void recv_mesh(struct mesh_conn *c, const linkaddr_t *from, uint8_t hops) {
+	struct transport_hdr hdr;
+	linkaddr_t sender;
+
+	if (packetbuf_datalen()<sizeof(hdr))
+		return;
+	memcpy(&hdr, packetbuf_dataptr(), sizeof(hdr));
+	linkaddr_copy(&sender, from);
+
+	if (hdr.type==TRANSPORT_ACK) {
+		if (pending!=NULL && hdr.seqno==pending_seqno && linkaddr_cmp(&sender, &pending_to)) {
+			ctimer_stop(&retransmit_timer);
+			queuebuf_free(pending);
+			pending = NULL;
+			callbacks->sent(&sender, retransmissions);
+		}
+		return;
+	}
+
+	packetbuf_hdrreduce(sizeof(hdr));
+	TRACE_RADIO(TRACE_RX, sender.u8[0], channel);
+	if (!duplicate(&sender, hdr.seqno))
+		callbacks->recv(&sender, hdr.seqno);
+
+	//acknowledge the duplicates too: the previous ack may have been lost
+	hdr.type = TRANSPORT_ACK;
+	packetbuf_clear();
+	packetbuf_copyfrom(&hdr, sizeof(hdr));
+	mesh_send(&mesh, &sender);
+}
+
+static void sent_mesh(struct mesh_conn *c) {
+}
+
+static void timedout_mesh(struct mesh_conn *c) {
+	//no route found: the frame is retransmitted when the timer expires
+}
+
+static const struct mesh_callbacks mesh_calls = {recv_mesh, sent_mesh, timedout_mesh};
+
+void transport_open(uint16_t c, const struct transport_callbacks *cb) {
+	callbacks = cb;
+	channel = c;
+	route_set_lifetime(TRANSPORT_ROUTE_LIFETIME);
+	mesh_open(&mesh, channel, &mesh_calls);
+}
+
+void transport_close(void) {
+	ctimer_stop(&retransmit_timer);
+	if (pending!=NULL) {
+		queuebuf_free(pending);
+		pending = NULL;
+	}
+	mesh_close(&mesh);
+}
+
+int transport_send(const linkaddr_t *to, uint8_t max) {
+	struct transport_hdr *hdr;
+
+	if (pending!=NULL || !packetbuf_hdralloc(sizeof(*hdr)))
+		return 0;
+	hdr = (struct transport_hdr*)packetbuf_hdrptr();
+	hdr->type = TRANSPORT_DATA;
+	hdr->seqno = pending_seqno = seqno++;
+
+	pending = queuebuf_new_from_packetbuf();
+	if (pending==NULL)
+		return 0;
+	linkaddr_copy(&pending_to, to);
+	retransmissions = 0;
+	max_retransmissions = max;
+	send_pending();
+	return 1;
+}
+
+int transport_is_transmitting(void) {
+	return pending!=NULL;
+}
+
+#else /* TRANSPORT_MESH */
+
+static struct runicast_conn runicast;
+
+static void recv_runicast(struct runicast_conn *c, const linkaddr_t *from, uint8_t seqno) {
+	TRACE_RADIO(TRACE_RX, from->u8[0], channel);
+	callbacks->recv(from, seqno);
+}
+
+//runicast retransmits on its own: the retransmissions are traced at the end
+static void sent_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
+	if (retransmissions>0)
+		TRACE_ERROR(TRACE_RETRANSMISSION, to->u8[0], retransmissions);
+	callbacks->sent(to, retransmissions);
+}
+
+static void timedout_runicast(struct runicast_conn *c, const linkaddr_t *to, uint8_t retransmissions) {
+	TRACE_ERROR(TRACE_TIMEOUT, to->u8[0], retransmissions);
+	callbacks->timedout(to, retransmissions);
+}
+
+static const struct runicast_callbacks runicast_calls = {recv_runicast, sent_runicast, timedout_runicast};
+
+void transport_open(uint16_t c, const struct transport_callbacks *cb) {
+	callbacks = cb;
+	channel = c;
+	runicast_open(&runicast, channel, &runicast_calls);
+}
+
+void transport_close(void) {
+	runicast_close(&runicast);
+}
+
+int transport_send(const linkaddr_t *to, uint8_t max_retransmissions) {
+	TRACE_RADIO(TRACE_TX, to->u8[0], channel);
+	return runicast_send(&runicast, to, max_retransmissions);
+}
+
+int transport_is_transmitting(void) {
+	return runicast_is_transmitting(&runicast);
+}
+
+#endif /* TRANSPORT_MESH */
@@ -0,0 +1,81 @@
+/*
+ * Reliable unicast between the CU and the nodes, single-hop or multi-hop.
+ *
+ * By default the transport is a plain runicast connection, so every node must
+ * be in the radio range of the CU. With TRANSPORT_CONF_MESH set, frames travel
+ * over Rime mesh instead: routes are discovered on demand, cached in the route
+ * table for TRANSPORT_ROUTE_LIFETIME seconds and refreshed while they are
+ * used, so a node out of range (e.g. Node2 at the far end of the garden) is
+ * reached through the nodes in between. Mesh is not reliable, so the
+ * transport adds end-to-end acknowledgements: a 2-byte header (type, seqno),
+ * retransmission after TRANSPORT_TIMEOUT and suppression of the duplicates.
+ *
+ * In both cases there is one connection per node, with the same callbacks as
+ * runicast. In mesh mode the broadcast commands do not cross the hops, so the
+ * CU sends them in unicast to every node that implements them, and the nodes
+ * register at the CU (TRANSPORT_SINK) with a frame instead of relying on the
+ * one-hop announcements only (see registry.h).
+ *
+ * Mesh uses three consecutive channels starting from the one of the
+ * transport.
+ */
+
+#ifndef TRANSPORT_H_
+#define TRANSPORT_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+#include "home.h"
+
+#ifdef TRANSPORT_CONF_MESH
+#define TRANSPORT_MESH TRANSPORT_CONF_MESH
+#else
+#define TRANSPORT_MESH 0
+#endif
+
+//time to wait for the end-to-end acknowledgement before retransmitting
+#ifdef TRANSPORT_CONF_TIMEOUT
+#define TRANSPORT_TIMEOUT TRANSPORT_CONF_TIMEOUT
+#else
+#define TRANSPORT_TIMEOUT (4*CLOCK_SECOND)
+#endif
+
+//seconds a discovered route stays in the route table when unused
+#ifdef TRANSPORT_CONF_ROUTE_LIFETIME
+#define TRANSPORT_ROUTE_LIFETIME TRANSPORT_CONF_ROUTE_LIFETIME
+#else
+#define TRANSPORT_ROUTE_LIFETIME 300
+#endif
+
+//senders whose last sequence number is remembered to drop the duplicates
+#ifdef TRANSPORT_CONF_PEERS
+#define TRANSPORT_PEERS TRANSPORT_CONF_PEERS
+#else
+#define TRANSPORT_PEERS 4
+#endif
+
+//rime address of the CU, where the nodes register in mesh mode
+#ifdef TRANSPORT_CONF_SINK
+#define TRANSPORT_SINK TRANSPORT_CONF_SINK
+#else
+#define TRANSPORT_SINK HOME_ADDR_CentralUnit
+#endif
+
+struct transport_callbacks {
+	void (*recv)(const linkaddr_t *from, uint8_t seqno);
+	void (*sent)(const linkaddr_t *to, uint8_t retransmissions);
+	void (*timedout)(const linkaddr_t *to, uint8_t retransmissions);
+};
+
+void transport_open(uint16_t channel, const struct transport_callbacks *callbacks);
+void transport_close(void);
+
+/* Send the frame in the packetbuf to a node. Returns 0 if a frame is already
+ in flight. */
+int transport_send(const linkaddr_t *to, uint8_t max_retransmissions);
+int transport_is_transmitting(void);
+
+/* Address of the CU (TRANSPORT_SINK.0). */
+void transport_sink(linkaddr_t *addr);
+
+#endif /* TRANSPORT_H_ */
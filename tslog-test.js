@@ -0,0 +1,18 @@
+/*
+ * Cooja ScriptRunner test for TslogTest: the time-series log must survive
+ * being reopened when it ends with an unchanged value.
+ *
+ * Run headless with
+ * 		java -jar cooja.jar -nogui=tslog-test.csc -contiki=<contiki dir>
+ * the result is written to COOJA.testlog.
+ */
+
+TIMEOUT(60000);
+
+while (true) {
+	if (msg.startsWith("TSLOG ok"))
+		log.testOK();
+	else if (msg.startsWith("TSLOG FAIL"))
+		log.testFailed();
+	YIELD();
+}
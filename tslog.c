@@ -0,0 +1,273 @@
+/*
+ * Implementation of the time-series log (see tslog.h).
+ */
+
+#include "tslog.h"
+#include "cfs/cfs.h"
+#if CONTIKI_TARGET_SKY
+#include "cfs/cfs-coffee.h"
+#endif
+#include "message.h"
+#include <string.h>
+
+static char seg_names[2][16];
+static uint8_t cur_seg = 0;
+static cfs_offset_t cur_size = 0;
+
+//log time at boot: the log goes on from its last sample
+static unsigned long time_base = 0;
+
+//samples not written to flash yet
+static struct tslog_encoder writer;
+static uint8_t wbuf[TSLOG_FLUSH+TSLOG_RECORD_MAX];
+static uint8_t wlen = 0;
+
+//state of the export in progress
+static struct {
+	unsigned long from, to, now;
+	int fd;
+	uint8_t seg, segs_left;
+	struct tslog_decoder in;
+	struct tslog_encoder out;
+	uint8_t pending[TSLOG_RECORD_MAX];
+	uint8_t pending_len, pending_pos;
+	int produced;
+	uint8_t rbuf[16];
+	uint8_t rlen, rpos;
+} ex = { .fd = -1 };
+
+static void reserve(uint8_t seg) {
+#if CONTIKI_TARGET_SKY
+	//preallocate the segment so that appending never relocates the file
+	cfs_coffee_reserve(seg_names[seg], TSLOG_SEGMENT_SIZE);
+#endif
+}
+
+//decode a whole segment: returns the time of its last sample
+static unsigned long scan(uint8_t seg, cfs_offset_t *size) {
+	struct tslog_decoder d;
+	uint8_t buf[16];
+	unsigned long last = 0;
+	int fd, n, i;
+
+	*size = 0;
+	fd = cfs_open(seg_names[seg], CFS_READ);
+	if (fd<0)
+		return 0;
+
+	tslog_decoder_init(&d, 0);
+	while ((n = cfs_read(fd, buf, sizeof(buf))) > 0) {
+		for (i=0; i<n; i++) {
+			if (tslog_decode(&d, buf[i]))
+				last = d.time;
+		}
+		*size += n;
+	}
+	cfs_close(fd);
+
+	return last;
+}
+
+void tslog_init(const char *name) {
+	unsigned long last0, last1;
+	cfs_offset_t size0, size1;
+
+	strncpy(seg_names[0], name, sizeof(seg_names[0])-3);
+	strncpy(seg_names[1], name, sizeof(seg_names[1])-3);
+	strcat(seg_names[0], ".0");
+	strcat(seg_names[1], ".1");
+
+	last0 = scan(0, &size0);
+	last1 = scan(1, &size1);
+	if (size0==0 && size1==0)
+		reserve(0);
+
+	//the current segment is the one with the most recent samples
+	cur_seg = (last1>last0)? 1:0;
+	cur_size = (cur_seg==1)? size1:size0;
+	time_base = ((last1>last0)? last1:last0)+1;
+
+	//the first sample after a reboot is always an anchor
+	writer.started = 0;
+	wlen = 0;
+}
+
+unsigned long tslog_now(void) {
+	return time_base+clock_seconds();
+}
+
+int tslog_encode(struct tslog_encoder *e, unsigned long time, int16_t value,
+		uint8_t *out) {
+	int dv = value-e->value;
+	int len;
+
+	if (e->started && time>e->time && time-e->time<TSLOG_ANCHOR
+			&& dv>=-127 && dv<=127) {
+		out[0] = time-e->time;
+		out[1] = dv+128;
+		len = 2;
+	} else {
+		out[0] = TSLOG_ANCHOR;
+		msg_put_uint32(&out[1], time);
+		out[5] = (uint16_t)value & 0xff;
+		out[6] = (uint16_t)value >> 8;
+		//a record never ends with 0 (see tslog.h)
+		out[7] = TSLOG_ANCHOR;
+		len = 8;
+	}
+
+	e->time = time;
+	e->value = value;
+	e->started = 1;
+
+	return len;
+}
+
+void tslog_flush(void) {
+	int fd;
+
+	if (wlen==0)
+		return;
+
+	fd = cfs_open(seg_names[cur_seg], CFS_WRITE | CFS_APPEND);
+	if (fd>=0) {
+		cfs_write(fd, wbuf, wlen);
+		cfs_close(fd);
+		cur_size += wlen;
+	}
+	wlen = 0;
+}
+
+void tslog_append(int16_t value) {
+	if (cur_size+wlen+TSLOG_RECORD_MAX > TSLOG_SEGMENT_SIZE) {
+		//the current segment is full: erase the older one and go on there
+		tslog_flush();
+		cur_seg ^= 1;
+		cfs_remove(seg_names[cur_seg]);
+		reserve(cur_seg);
+		cur_size = 0;
+		//every segment starts with an anchor
+		writer.started = 0;
+	}
+
+	wlen += tslog_encode(&writer, tslog_now(), value, &wbuf[wlen]);
+	if (wlen>=TSLOG_FLUSH)
+		tslog_flush();
+}
+
+static void export_restart(void) {
+	if (ex.fd>=0)
+		cfs_close(ex.fd);
+	ex.fd = -1;
+
+	//older segment first
+	ex.seg = cur_seg^1;
+	ex.segs_left = 2;
+	ex.rlen = ex.rpos = 0;
+	tslog_decoder_init(&ex.in, 0);
+	ex.out.started = 0;
+
+	//stream header
+	msg_put_uint32(ex.pending, ex.now);
+	ex.pending_len = 4;
+	ex.pending_pos = 0;
+	ex.produced = 0;
+}
+
+void tslog_export_start(unsigned long from_age, unsigned long to_age) {
+	//the samples still in RAM are part of the export too
+	tslog_flush();
+
+	ex.now = tslog_now();
+	ex.from = (ex.now>from_age)? ex.now-from_age:0;
+	ex.to = (ex.now>to_age)? ex.now-to_age:0;
+	export_restart();
+}
+
+static int next_byte(uint8_t *b) {
+	int n;
+
+	while (ex.rpos>=ex.rlen) {
+		if (ex.fd<0) {
+			if (ex.segs_left==0)
+				return 0;
+			ex.fd = cfs_open(seg_names[ex.seg], CFS_READ);
+			ex.seg ^= 1;
+			ex.segs_left--;
+			//a segment starts with an anchor: drop any partial record
+			tslog_decoder_init(&ex.in, 0);
+			continue;
+		}
+		n = cfs_read(ex.fd, ex.rbuf, sizeof(ex.rbuf));
+		if (n<=0) {
+			cfs_close(ex.fd);
+			ex.fd = -1;
+			continue;
+		}
+		ex.rlen = n;
+		ex.rpos = 0;
+	}
+
+	*b = ex.rbuf[ex.rpos++];
+	return 1;
+}
+
+int tslog_export_read(int offset, uint8_t *to, int maxsize) {
+	int len = 0;
+	uint8_t b;
+
+	//a chunk that has already been produced: generate the stream again
+	if (offset < ex.produced)
+		export_restart();
+
+	while (len<maxsize) {
+		if (ex.pending_pos<ex.pending_len) {
+			b = ex.pending[ex.pending_pos++];
+			if (ex.produced++ >= offset)
+				to[len++] = b;
+		} else if (next_byte(&b)) {
+			if (tslog_decode(&ex.in, b) && ex.in.time>=ex.from && ex.in.time<=ex.to) {
+				ex.pending_len = tslog_encode(&ex.out, ex.in.time, ex.in.value, ex.pending);
+				ex.pending_pos = 0;
+			}
+		} else
+			break;
+	}
+
+	return len;
+}
+
+void tslog_decoder_init(struct tslog_decoder *d, int with_header) {
+	d->len = 0;
+	d->header = with_header? 4:0;
+	d->synced = 0;
+}
+
+int tslog_decode(struct tslog_decoder *d, uint8_t byte) {
+	if (d->header>0) {
+		d->buf[4-d->header] = byte;
+		if (--d->header==0)
+			d->now = msg_get_uint32(d->buf);
+		return 0;
+	}
+
+	if (d->len==0)
+		d->need = (byte==TSLOG_ANCHOR)? 8:2;
+	d->buf[d->len++] = byte;
+	if (d->len<d->need)
+		return 0;
+	d->len = 0;
+
+	if (d->need==8) {
+		d->time = msg_get_uint32(&d->buf[1]);
+		d->value = (int16_t)(d->buf[5] | (d->buf[6] << 8));
+		d->synced = 1;
+	} else if (d->synced) {
+		d->time += d->buf[0];
+		d->value += (int)d->buf[1]-128;
+	} else
+		//a delta before any anchor cannot be decoded
+		return 0;
+
+	return 1;
+}
@@ -0,0 +1,85 @@
+/*
+ * Append-only, delta-encoded time-series log on flash (Coffee on sky, the
+ * POSIX file system on native).
+ *
+ * A sample is a 16-bit value stamped with the log time, i.e. the seconds of
+ * uptime of the node accumulated across reboots (at boot the log restarts
+ * from the time of its last sample). Samples are encoded as:
+ * 		anchor: TSLOG_ANCHOR, time (4 bytes), value (2 bytes), TSLOG_ANCHOR
+ * 		delta:  dt (1 byte, 1..254 s), dv+128 (1 byte, dv in -127..127)
+ * so a sample costs 2 bytes unless the gap or the change is too big to fit.
+ * The last byte of a record is never 0: Coffee finds the end of a file by
+ * skipping its trailing zeros, so a log ending with, e.g., an unchanged value
+ * would otherwise look shorter after a reboot and be appended to at the wrong
+ * offset.
+ * Encoded samples are buffered in RAM and written to flash in blocks of
+ * TSLOG_FLUSH bytes to keep the number of flash writes low. The log lives in
+ * two segments of TSLOG_SEGMENT_SIZE bytes: when the current one is full the
+ * older one is erased and reused.
+ *
+ * A time range can be exported as a stream made of the log time at the moment
+ * of the export (4 bytes) followed by the samples of the range, re-encoded
+ * starting from an anchor. tslog_export_read() is meant to be called by the
+ * rucb read_chunk callback, so the stream is sent with rucb as it is; the
+ * receiver feeds each byte to tslog_decode().
+ */
+
+#ifndef TSLOG_H_
+#define TSLOG_H_
+
+#include "contiki.h"
+
+#ifdef TSLOG_CONF_SEGMENT_SIZE
+#define TSLOG_SEGMENT_SIZE TSLOG_CONF_SEGMENT_SIZE
+#else
+#define TSLOG_SEGMENT_SIZE 2048
+#endif
+
+#ifdef TSLOG_CONF_FLUSH
+#define TSLOG_FLUSH TSLOG_CONF_FLUSH
+#else
+#define TSLOG_FLUSH 32
+#endif
+
+#define TSLOG_ANCHOR 0xff
+#define TSLOG_RECORD_MAX 8
+
+struct tslog_encoder {
+	unsigned long time;
+	int16_t value;
+	uint8_t started;
+};
+
+struct tslog_decoder {
+	unsigned long now; //log time of the export (stream header)
+	unsigned long time;
+	int16_t value;
+	uint8_t buf[TSLOG_RECORD_MAX];
+	uint8_t len;
+	uint8_t need;
+	uint8_t header;
+	uint8_t synced;
+};
+
+/* Open the log of the given name and restore the log time. */
+void tslog_init(const char *name);
+void tslog_append(int16_t value);
+void tslog_flush(void);
+unsigned long tslog_now(void);
+
+/* Encode a sample, returns the number of bytes written in out. */
+int tslog_encode(struct tslog_encoder *e, unsigned long time, int16_t value,
+		uint8_t *out);
+
+/* Prepare the export of the samples taken between from_age and to_age seconds
+ ago. */
+void tslog_export_start(unsigned long from_age, unsigned long to_age);
+int tslog_export_read(int offset, uint8_t *to, int maxsize);
+
+/* Feed one byte of an export stream (with_header: the stream starts with the
+ log time of the export, stored in d->now). Returns 1 when d->time/d->value
+ hold a new sample. */
+void tslog_decoder_init(struct tslog_decoder *d, int with_header);
+int tslog_decode(struct tslog_decoder *d, uint8_t byte);
+
+#endif /* TSLOG_H_ */
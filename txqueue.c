@@ -0,0 +1,69 @@
+/*
+ * Implementation of the outbound queue (see txqueue.h).
+ */
+
+#include "txqueue.h"
+
+static void kick(struct txqueue *q);
+
+static void retry(void *ptr) {
+	kick((struct txqueue*)ptr);
+}
+
+static void kick(struct txqueue *q) {
+	struct packetqueue *pq;
+
+	if (q->busy)
+		return;
+
+	//urgent frames jump ahead of the normal ones
+	pq = (packetqueue_len(q->urgent)>0)? q->urgent:q->normal;
+	if (packetqueue_len(pq)==0)
+		return;
+
+	queuebuf_to_packetbuf(packetqueue_queuebuf(packetqueue_first(pq)));
+
+	//the frame leaves the queue only once the connection has taken it
+	q->busy = 1;
+	if (!q->transmit(q)) {
+		q->busy = 0;
+		ctimer_set(&q->retry, TXQUEUE_RETRY_TIME, retry, q);
+		return;
+	}
+	packetqueue_dequeue(pq);
+	ctimer_stop(&q->retry);
+}
+
+void txqueue_init(struct txqueue *q, void *conn, const linkaddr_t *dest,
+		int (*transmit)(struct txqueue *q)) {
+	packetqueue_init(q->urgent);
+	packetqueue_init(q->normal);
+	q->conn = conn;
+	linkaddr_copy(&q->dest, dest);
+	q->transmit = transmit;
+	q->busy = 0;
+}
+
+int txqueue_enqueue(struct txqueue *q, int urgent) {
+	//no lifetime: a queued command is never silently discarded
+	if (!packetqueue_enqueue_packetbuf(urgent? q->urgent:q->normal, 0, NULL))
+		return 0;
+
+	kick(q);
+	return 1;
+}
+
+int txqueue_enqueue_to(struct txqueue *q, const linkaddr_t *dest, int urgent) {
+	//the addresses of the packetbuf are saved in the queuebuf with the frame
+	packetbuf_set_addr(PACKETBUF_ADDR_RECEIVER, dest);
+	return txqueue_enqueue(q, urgent);
+}
+
+void txqueue_done(struct txqueue *q) {
+	q->busy = 0;
+	kick(q);
+}
+
+int txqueue_len(struct txqueue *q) {
+	return packetqueue_len(q->urgent)+packetqueue_len(q->normal)+q->busy;
+}
@@ -0,0 +1,67 @@
+/*
+ * Bounded outbound queue of a connection, built on Contiki's packetqueue.
+ *
+ * Each queue holds two packetqueues: urgent frames (e.g. the alarm command)
+ * are always transmitted before normal ones (gate, queries...). Frames are
+ * enqueued straight from the packetbuf, so the caller builds the frame with
+ * msg_init()/msg_add() and then calls txqueue_enqueue().
+ *
+ * At most one frame per queue is in flight: the transmit callback is invoked
+ * with the frame loaded in the packetbuf, and the owner of the connection must
+ * call txqueue_done() from its sent/timedout callbacks to release the queue.
+ * A frame stays at the head of its queue until the transmit callback accepts
+ * it: if the connection refuses it (busy, or no queuebuf left), it is tried
+ * again after TXQUEUE_RETRY_TIME.
+ *
+ * A queue can be shared by all the destinations of a multiplexed connection:
+ * txqueue_enqueue_to() stores the destination of each frame in the packetbuf,
+ * and the transmit callback finds it again in PACKETBUF_ADDR_RECEIVER. This
+ * is how the CU uses it, since the transport has a single frame in flight
+ * for all the nodes (see transport.h): the frames to different nodes are
+ * sent one after the other, and a node that does not answer holds the
+ * others back until its frame times out.
+ */
+
+#ifndef TXQUEUE_H_
+#define TXQUEUE_H_
+
+#include "contiki.h"
+#include "net/rime/rime.h"
+
+//wait before trying again a frame the connection has refused
+#ifdef TXQUEUE_CONF_RETRY_TIME
+#define TXQUEUE_RETRY_TIME TXQUEUE_CONF_RETRY_TIME
+#else
+#define TXQUEUE_RETRY_TIME (CLOCK_SECOND/4)
+#endif
+
+struct txqueue {
+	struct packetqueue *urgent;
+	struct packetqueue *normal;
+	void *conn;
+	linkaddr_t dest;
+	int (*transmit)(struct txqueue *q);
+	struct ctimer retry;
+	uint8_t busy;
+};
+
+#define TXQUEUE(name, size) \
+	PACKETQUEUE(name##_urgent, size); \
+	PACKETQUEUE(name##_normal, size); \
+	static struct txqueue name = { &name##_urgent, &name##_normal }
+
+void txqueue_init(struct txqueue *q, void *conn, const linkaddr_t *dest,
+		int (*transmit)(struct txqueue *q));
+
+/* Enqueue the frame in the packetbuf. Returns 0 if the queue is full. */
+int txqueue_enqueue(struct txqueue *q, int urgent);
+
+/* Same as txqueue_enqueue(), for a frame addressed to dest. */
+int txqueue_enqueue_to(struct txqueue *q, const linkaddr_t *dest, int urgent);
+
+/* The frame in flight has been sent (or has timed out): send the next one. */
+void txqueue_done(struct txqueue *q);
+
+int txqueue_len(struct txqueue *q);
+
+#endif /* TXQUEUE_H_ */
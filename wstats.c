@@ -0,0 +1,102 @@
+/*
+ * Implementation of the windowed statistics (see wstats.h).
+ */
+
+#include "wstats.h"
+
+//i-th element of a circular queue of sample positions
+static uint8_t *queue_at(struct wstats *w, uint8_t *q, uint8_t first, uint8_t i) {
+	return &q[(first+i)%w->size];
+}
+
+void wstats_init(struct wstats *w) {
+	w->count = 0;
+	w->head = 0;
+	w->minq_first = w->minq_len = 0;
+	w->maxq_first = w->maxq_len = 0;
+	w->sum = 0;
+	w->sumsq = 0;
+	w->wsum = 0;
+	w->weight = 0;
+}
+
+void wstats_add(struct wstats *w, int16_t sample) {
+	wstats_add_weighted(w, sample, 1);
+}
+
+void wstats_add_weighted(struct wstats *w, int16_t sample, uint16_t weight) {
+	uint8_t pos = w->head;
+
+	//the weighted sum of a full window only fits in 32 bits up to WSTATS_MAX_WEIGHT
+	if (weight==0)
+		weight = 1;
+	else if (weight>WSTATS_MAX_WEIGHT)
+		weight = WSTATS_MAX_WEIGHT;
+
+	if (w->count==w->size) {
+		//the window is full: the oldest sample (at pos) leaves it
+		int16_t old = w->samples[pos];
+		w->sum -= old;
+		w->sumsq -= (int32_t)old*old;
+		w->wsum -= (int32_t)old*w->weights[pos];
+		w->weight -= w->weights[pos];
+		if (w->minq_len>0 && w->minq[w->minq_first]==pos) {
+			w->minq_first = (w->minq_first+1)%w->size;
+			w->minq_len--;
+		}
+		if (w->maxq_len>0 && w->maxq[w->maxq_first]==pos) {
+			w->maxq_first = (w->maxq_first+1)%w->size;
+			w->maxq_len--;
+		}
+	} else
+		w->count++;
+
+	w->samples[pos] = sample;
+	w->sum += sample;
+	w->sumsq += (int32_t)sample*sample;
+	w->weights[pos] = weight;
+	w->wsum += (int32_t)sample*weight;
+	w->weight += weight;
+
+	/*samples that are older and not smaller (not greater) than the new one
+	 can never be the minimum (maximum) again*/
+	while (w->minq_len>0
+			&& w->samples[*queue_at(w, w->minq, w->minq_first, w->minq_len-1)] >= sample)
+		w->minq_len--;
+	*queue_at(w, w->minq, w->minq_first, w->minq_len++) = pos;
+
+	while (w->maxq_len>0
+			&& w->samples[*queue_at(w, w->maxq, w->maxq_first, w->maxq_len-1)] <= sample)
+		w->maxq_len--;
+	*queue_at(w, w->maxq, w->maxq_first, w->maxq_len++) = pos;
+
+	w->head = (pos+1)%w->size;
+}
+
+uint8_t wstats_count(struct wstats *w) {
+	return w->count;
+}
+
+int16_t wstats_mean(struct wstats *w) {
+	return w->wsum/(int32_t)w->weight;
+}
+
+int16_t wstats_min(struct wstats *w) {
+	return w->samples[w->minq[w->minq_first]];
+}
+
+int16_t wstats_max(struct wstats *w) {
+	return w->samples[w->maxq[w->maxq_first]];
+}
+
+uint32_t wstats_variance(struct wstats *w) {
+	/*var = (sumsq - sum^2/n)/n, rounded down like (n*sumsq - sum^2)/n^2. With
+	 |sum| = q*n+r, ceil(sum^2/n) = q*q*n + 2*q*r + ceil(r*r/n) never exceeds
+	 sumsq+1, so everything fits in 32 bits (no int64 on the MSP430, the pacer
+	 asks for the variance at every sample)*/
+	uint32_t n = w->count;
+	uint32_t a = (w->sum<0)? -w->sum:w->sum;
+	uint32_t q = a/n, r = a%n;
+
+	return (w->sumsq - (q*q*n + 2*q*r + (r*r+n-1)/n))/n;
+}
@@ -0,0 +1,71 @@
+/*
+ * Windowed statistics over the last N samples, updated in O(1) per sample.
+ *
+ * The window keeps the running sum and sum of squares of the samples, so the
+ * mean and the variance never require a rescan, and two monotonic queues of
+ * sample positions, so the minimum and the maximum are always at the front of
+ * their queue (amortized O(1) per sample). The window size is fixed at compile
+ * time by the WSTATS() declaration:
+ * 		WSTATS(temp_stats, 60);
+ * 		wstats_init(&temp_stats);
+ * 		wstats_add(&temp_stats, sample);
+ *
+ * Samples are 16-bit fixed-point values in whatever unit the caller uses (e.g.
+ * tenths of degree); they must stay within +/-4095 so that the sum of squares
+ * of a full window (up to 255 samples) fits in 32 bits.
+ *
+ * When the samples are not evenly spaced, wstats_add_weighted() gives each of
+ * them the time it stands for (e.g. the seconds since the previous sample,
+ * clamped to 1..WSTATS_MAX_WEIGHT) and the mean is weighted by it, so a burst of close samples does not
+ * outweigh a long stable stretch. wstats_add() gives every sample weight 1.
+ * The variance, the minimum and the maximum are not weighted: the variance is
+ * the one of the samples, around their plain mean, even when wstats_mean()
+ * is weighted.
+ */
+
+#ifndef WSTATS_H_
+#define WSTATS_H_
+
+#include "contiki.h"
+
+//largest weight of a sample: 255 samples of 4095 times it fit in 32 bits
+#define WSTATS_MAX_WEIGHT 2048
+
+struct wstats {
+	int16_t *samples;
+	uint16_t *weights;
+	uint8_t *minq;
+	uint8_t *maxq;
+	uint8_t size;
+	uint8_t count;
+	uint8_t head; //position of the next sample
+	uint8_t minq_first, minq_len;
+	uint8_t maxq_first, maxq_len;
+	int32_t sum;
+	uint32_t sumsq;
+	int32_t wsum; //sum of the samples times their weight
+	uint32_t weight; //sum of the weights
+};
+
+#define WSTATS(name, window) \
+	static int16_t name##_samples[window]; \
+	static uint16_t name##_weights[window]; \
+	static uint8_t name##_minq[window]; \
+	static uint8_t name##_maxq[window]; \
+	static struct wstats name = { name##_samples, name##_weights, name##_minq, name##_maxq, window }
+
+void wstats_init(struct wstats *w);
+void wstats_add(struct wstats *w, int16_t sample);
+void wstats_add_weighted(struct wstats *w, int16_t sample, uint16_t weight);
+
+uint8_t wstats_count(struct wstats *w);
+
+/* The following are meaningless if wstats_count() is 0. */
+/* Mean weighted by the weight of the samples. */
+int16_t wstats_mean(struct wstats *w);
+int16_t wstats_min(struct wstats *w);
+int16_t wstats_max(struct wstats *w);
+/* Population variance, in the square of the sample unit. */
+uint32_t wstats_variance(struct wstats *w);
+
+#endif /* WSTATS_H_ */